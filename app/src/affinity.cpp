@@ -0,0 +1,222 @@
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+#if defined(linux)
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fstream>
+#include <pthread.h>
+#include <sched.h>
+#include <set>
+#include <tuple>
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+
+#include "affinity.h"
+
+
+affinity_mode_t affinity_mode = AFFINITY_NONE;
+bool            numa_bind     = false;
+
+std::optional<affinity_mode_t> affinity_mode_from_string(const std::string & name)
+{
+	if (name == "none")
+		return AFFINITY_NONE;
+	if (name == "compact")
+		return AFFINITY_COMPACT;
+	if (name == "scatter")
+		return AFFINITY_SCATTER;
+
+	return { };
+}
+
+const char *affinity_mode_name(const affinity_mode_t mode)
+{
+	if (mode == AFFINITY_COMPACT)
+		return "compact";
+	if (mode == AFFINITY_SCATTER)
+		return "scatter";
+
+	return "none";
+}
+
+#if defined(linux)
+typedef struct {
+	int cpu;
+	int core;
+	int package;
+	int node;
+	int smt_index;  // 0 for the first hardware thread of a core
+} cpu_t;
+
+static int read_int(const std::string & file, const int default_value)
+{
+	std::ifstream fh(file);
+	int value = default_value;
+	if (!(fh >> value))
+		return default_value;
+
+	return value;
+}
+
+// no libnuma: everything comes from /sys
+static std::vector<cpu_t> get_topology()
+{
+	std::vector<cpu_t> out;
+
+	long n_cpus = sysconf(_SC_NPROCESSORS_CONF);
+	for(int cpu=0; cpu<n_cpus; cpu++) {
+		std::string base = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+
+		if (read_int(base + "/online", 1) == 0)
+			continue;
+
+		cpu_t c { cpu, read_int(base + "/topology/core_id", cpu), read_int(base + "/topology/physical_package_id", 0), 0, 0 };
+
+		DIR *dir = opendir(base.c_str());
+		if (dir) {
+			while(dirent *de = readdir(dir)) {
+				if (strncmp(de->d_name, "node", 4) == 0 && isdigit(de->d_name[4])) {
+					c.node = atoi(&de->d_name[4]);
+					break;
+				}
+			}
+			closedir(dir);
+		}
+
+		out.push_back(c);
+	}
+
+	for(auto & c: out) {
+		for(auto & other: out) {
+			if (other.cpu < c.cpu && other.core == c.core && other.package == c.package)
+				c.smt_index++;
+		}
+	}
+
+	return out;
+}
+
+static const std::vector<cpu_t> & get_cached_topology()
+{
+	static const std::vector<cpu_t> topology = get_topology();
+
+	return topology;
+}
+
+static std::vector<cpu_t> get_placement_order(const affinity_mode_t mode)
+{
+	std::vector<cpu_t> order = get_cached_topology();
+
+	// one hardware thread per core of every node first, SMT siblings last
+	std::sort(order.begin(), order.end(), [](const cpu_t & a, const cpu_t & b) {
+			return std::tie(a.smt_index, a.node, a.package, a.core, a.cpu) < std::tie(b.smt_index, b.node, b.package, b.core, b.cpu);
+		});
+
+	if (mode == AFFINITY_SCATTER) {
+		// round-robin over the nodes
+		std::vector<int> index_in_node(order.size());
+		std::vector<int> count_per_node;
+		for(size_t i=0; i<order.size(); i++) {
+			size_t node = order[i].node;
+			if (node >= count_per_node.size())
+				count_per_node.resize(node + 1);
+			index_in_node[i] = count_per_node[node]++;
+		}
+
+		std::vector<size_t> indexes(order.size());
+		for(size_t i=0; i<indexes.size(); i++)
+			indexes[i] = i;
+		std::stable_sort(indexes.begin(), indexes.end(), [&](const size_t a, const size_t b) { return index_in_node[a] < index_in_node[b]; });
+
+		std::vector<cpu_t> scattered;
+		for(auto i: indexes)
+			scattered.push_back(order[i]);
+		order = scattered;
+	}
+
+	return order;
+}
+
+// only the pages that are completely within the memory range are moved
+static bool bind_memory(void *const memory, const size_t memory_size, const int node)
+{
+	constexpr int mpol_preferred = 1;
+	constexpr int mpol_mf_move   = 1 << 1;
+
+	uintptr_t page  = sysconf(_SC_PAGESIZE);
+	uintptr_t start = (uintptr_t(memory) + page - 1) & ~(page - 1);
+	uintptr_t end   = (uintptr_t(memory) + memory_size) & ~(page - 1);
+	if (end <= start)
+		return true;
+
+	constexpr int bits_per_long = sizeof(unsigned long) * 8;
+	unsigned long nodemask[1024 / bits_per_long] { };
+	if (node >= 1024)
+		return false;
+	nodemask[node / bits_per_long] |= 1ul << (node % bits_per_long);
+
+	return syscall(SYS_mbind, start, end - start, mpol_preferred, nodemask, sizeof(nodemask) * 8, mpol_mf_move) == 0;
+}
+#endif
+
+void report_topology()
+{
+#if defined(linux)
+	auto & topology = get_cached_topology();
+
+	std::set<std::pair<int, int> > cores;
+	std::set<int> packages;
+	std::set<int> nodes;
+	for(auto & c: topology) {
+		cores.insert({ c.package, c.core });
+		packages.insert(c.package);
+		nodes.insert(c.node);
+	}
+
+	printf("# topology: %zu cpus, %zu cores, %zu packages, %zu NUMA nodes; affinity: %s, NUMA bind: %s\n", topology.size(), cores.size(), packages.size(), nodes.size(), affinity_mode_name(affinity_mode), numa_bind ? "yes" : "no");
+#endif
+}
+
+void place_thread(const int thread_nr, void *const memory, const size_t memory_size)
+{
+#if defined(linux)
+	if (affinity_mode == AFFINITY_NONE && numa_bind == false)
+		return;
+
+	int cpu  = sched_getcpu();
+	int node = -1;
+
+	if (affinity_mode != AFFINITY_NONE) {
+		auto order = get_placement_order(affinity_mode);
+		if (order.empty())
+			return;
+
+		const cpu_t & c = order.at(thread_nr % order.size());
+
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(c.cpu, &set);
+		if (pthread_setaffinity_np(pthread_self(), sizeof set, &set))
+			printf("# cannot pin thread %d to cpu %d\n", thread_nr, c.cpu);
+
+		cpu  = c.cpu;
+		node = c.node;
+	}
+	else {
+		for(auto & c: get_cached_topology()) {
+			if (c.cpu == cpu)
+				node = c.node;
+		}
+	}
+
+	if (numa_bind && node >= 0 && bind_memory(memory, memory_size, node) == false)
+		printf("# cannot bind memory of thread %d to NUMA node %d\n", thread_nr, node);
+
+	printf("# thread %d on cpu %d, NUMA node %d\n", thread_nr, cpu, node);
+#endif
+}
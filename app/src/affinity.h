@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <string>
+
+
+// compact: fill the physical cores of one NUMA node first, scatter: spread over the nodes;
+// in both modes the SMT siblings are only used when all physical cores are taken
+typedef enum { AFFINITY_NONE, AFFINITY_COMPACT, AFFINITY_SCATTER } affinity_mode_t;
+
+extern affinity_mode_t affinity_mode;
+extern bool            numa_bind;
+
+std::optional<affinity_mode_t> affinity_mode_from_string(const std::string & name);
+const char                    *affinity_mode_name(const affinity_mode_t mode);
+
+void report_topology();
+// pins the calling thread and (optionally) moves "memory" to the NUMA node of its cpu
+void place_thread(const int thread_nr, void *const memory, const size_t memory_size);
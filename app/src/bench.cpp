@@ -0,0 +1,404 @@
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <libchess/Position.h>
+
+#include "bench.h"
+#include "main.h"
+#include "material.h"
+#include "search.h"
+#include "stats.h"
+#include "str.h"
+
+
+// these fens are taken from https://github.com/lynx-chess/Lynx/blob/main/src/Lynx/Bench.cs
+static const std::vector<std::string> bench_fens {
+        "r3k2r/2pb1ppp/2pp1q2/p7/1nP1B3/1P2P3/P2N1PPP/R2QK2R w KQkq a6 0 14",
+        "4rrk1/2p1b1p1/p1p3q1/4p3/2P2n1p/1P1NR2P/PB3PP1/3R1QK1 b - - 2 24",
+        "r3qbrk/6p1/2b2pPp/p3pP1Q/PpPpP2P/3P1B2/2PB3K/R5R1 w - - 16 42",
+        "6k1/1R3p2/6p1/2Bp3p/3P2q1/P7/1P2rQ1K/5R2 b - - 4 44",
+        "8/8/1p2k1p1/3p3p/1p1P1P1P/1P2PK2/8/8 w - - 3 54",
+        "7r/2p3k1/1p1p1qp1/1P1Bp3/p1P2r1P/P7/4R3/Q4RK1 w - - 0 36",
+        "r1bq1rk1/pp2b1pp/n1pp1n2/3P1p2/2P1p3/2N1P2N/PP2BPPP/R1BQ1RK1 b - - 2 10",
+        "3r3k/2r4p/1p1b3q/p4P2/P2Pp3/1B2P3/3BQ1RP/6K1 w - - 3 87",
+        "2r4r/1p4k1/1Pnp4/3Qb1pq/8/4BpPp/5P2/2RR1BK1 w - - 0 42",
+        "4q1bk/6b1/7p/p1p4p/PNPpP2P/KN4P1/3Q4/4R3 b - - 0 37",
+        "2q3r1/1r2pk2/pp3pp1/2pP3p/P1Pb1BbP/1P4Q1/R3NPP1/4R1K1 w - - 2 34",
+        "1r2r2k/1b4q1/pp5p/2pPp1p1/P3Pn2/1P1B1Q1P/2R3P1/4BR1K b - - 1 37",
+        "r3kbbr/pp1n1p1P/3ppnp1/q5N1/1P1pP3/P1N1B3/2P1QP2/R3KB1R b KQkq b3 0 17",
+        "8/6pk/2b1Rp2/3r4/1R1B2PP/P5K1/8/2r5 b - - 16 42",
+        "1r4k1/4ppb1/2n1b1qp/pB4p1/1n1BP1P1/7P/2PNQPK1/3RN3 w - - 8 29",
+        "8/p2B4/PkP5/4p1pK/4Pb1p/5P2/8/8 w - - 29 68",
+        "3r4/ppq1ppkp/4bnp1/2pN4/2P1P3/1P4P1/PQ3PBP/R4K2 b - - 2 20",
+        "5rr1/4n2k/4q2P/P1P2n2/3B1p2/4pP2/2N1P3/1RR1K2Q w - - 1 49",
+        "1r5k/2pq2p1/3p3p/p1pP4/4QP2/PP1R3P/6PK/8 w - - 1 51",
+        "q5k1/5ppp/1r3bn1/1B6/P1N2P2/BQ2P1P1/5K1P/8 b - - 2 34",
+        "r1b2k1r/5n2/p4q2/1ppn1Pp1/3pp1p1/NP2P3/P1PPBK2/1RQN2R1 w - - 0 22",
+        "r1bqk2r/pppp1ppp/5n2/4b3/4P3/P1N5/1PP2PPP/R1BQKB1R w KQkq - 0 5",
+        "r1bqr1k1/pp1p1ppp/2p5/8/3N1Q2/P2BB3/1PP2PPP/R3K2n b Q - 1 12",
+        "r1bq2k1/p4r1p/1pp2pp1/3p4/1P1B3Q/P2B1N2/2P3PP/4R1K1 b - - 2 19",
+        "r4qk1/6r1/1p4p1/2ppBbN1/1p5Q/P7/2P3PP/5RK1 w - - 2 25",
+        "r7/6k1/1p6/2pp1p2/7Q/8/p1P2K1P/8 w - - 0 32",
+        "r3k2r/ppp1pp1p/2nqb1pn/3p4/4P3/2PP4/PP1NBPPP/R2QK1NR w KQkq - 1 5",
+        "3r1rk1/1pp1pn1p/p1n1q1p1/3p4/Q3P3/2P5/PP1NBPPP/4RRK1 w - - 0 12",
+        "5rk1/1pp1pn1p/p3Brp1/8/1n6/5N2/PP3PPP/2R2RK1 w - - 2 20",
+        "8/1p2pk1p/p1p1r1p1/3n4/8/5R2/PP3PPP/4R1K1 b - - 3 27",
+        "8/4pk2/1p1r2p1/p1p4p/Pn5P/3R4/1P3PP1/4RK2 w - - 1 33",
+        "8/5k2/1pnrp1p1/p1p4p/P6P/4R1PK/1P3P2/4R3 b - - 1 38",
+        "8/8/1p1kp1p1/p1pr1n1p/P6P/1R4P1/1P3PK1/1R6 b - - 15 45",
+        "8/8/1p1k2p1/p1prp2p/P2n3P/6P1/1P1R1PK1/4R3 b - - 5 49",
+        "8/8/1p4p1/p1p2k1p/P2npP1P/4K1P1/1P6/3R4 w - - 6 54",
+        "8/8/1p4p1/p1p2k1p/P2n1P1P/4K1P1/1P6/6R1 b - - 6 59",
+        "8/5k2/1p4p1/p1pK3p/P2n1P1P/6P1/1P6/4R3 b - - 14 63",
+        "8/1R6/1p1K1kp1/p6p/P1p2P1P/6P1/1Pn5/8 w - - 0 67",
+        "1rb1rn1k/p3q1bp/2p3p1/2p1p3/2P1P2N/PP1RQNP1/1B3P2/4R1K1 b - - 4 23",
+        "4rrk1/pp1n1pp1/q5p1/P1pP4/2n3P1/7P/1P3PB1/R1BQ1RK1 w - - 3 22",
+        "r2qr1k1/pb1nbppp/1pn1p3/2ppP3/3P4/2PB1NN1/PP3PPP/R1BQR1K1 w - - 4 12",
+        "2r2k2/8/4P1R1/1p6/8/P4K1N/7b/2B5 b - - 0 55",
+        "6k1/5pp1/8/2bKP2P/2P5/p4PNb/B7/8 b - - 1 44",
+        "2rqr1k1/1p3p1p/p2p2p1/P1nPb3/2B1P3/5P2/1PQ2NPP/R1R4K w - - 3 25",
+        "r1b2rk1/p1q1ppbp/6p1/2Q5/8/4BP2/PPP3PP/2KR1B1R b - - 2 14",
+        "6r1/5k2/p1b1r2p/1pB1p1p1/1Pp3PP/2P1R1K1/2P2P2/3R4 w - - 1 36",
+        "rnbqkb1r/pppppppp/5n2/8/2PP4/8/PP2PPPP/RNBQKBNR b KQkq c3 0 2",
+        "2rr2k1/1p4bp/p1q1p1p1/4Pp1n/2PB4/1PN3P1/P3Q2P/2RR2K1 w - f6 0 20",
+        "3br1k1/p1pn3p/1p3n2/5pNq/2P1p3/1PN3PP/P2Q1PB1/4R1K1 w - - 0 23",
+        "2r2b2/5p2/5k2/p1r1pP2/P2pB3/1P3P2/K1P3R1/7R w - - 23 93",
+        "5k2/4q1p1/3P1pQb/1p1B4/pP5p/P1PR4/5PP1/1K6 b - - 0 38",
+        "6k1/6p1/8/6KQ/1r6/q2b4/8/8 w - - 0 32",
+        "5rk1/1rP3pp/p4n2/3Pp3/1P2Pq2/2Q4P/P5P1/R3R1K1 b - - 0 32",
+        "4r1k1/4r1p1/8/p2R1P1K/5P1P/1QP3q1/1P6/3R4 b - - 0 1",
+        "R4r2/4q1k1/2p1bb1p/2n2B1Q/1N2pP2/1r2P3/1P5P/2B2KNR w - - 3 31",
+        "r6k/pbR5/1p2qn1p/P2pPr2/4n2Q/1P2RN1P/5PBK/8 w - - 2 31",
+        "rn2k3/4r1b1/pp1p1n2/1P1q1p1p/3P4/P3P1RP/1BQN1PR1/1K6 w - - 6 28",
+        "3q1k2/3P1rb1/p6r/1p2Rp2/1P5p/P1N2pP1/5B1P/3QRK2 w - - 1 42",
+        "4r2k/1p3rbp/2p1N1p1/p3n3/P2NB1nq/1P6/4R1P1/B1Q2RK1 b - - 4 32",
+        "4r1k1/1q1r3p/2bPNb2/1p1R3Q/pB3p2/n5P1/6B1/4R1K1 w - - 2 36",
+        "3qr2k/1p3rbp/2p3p1/p7/P2pBNn1/1P3n2/6P1/B1Q1RR1K b - - 1 30",
+        "3qk1b1/1p4r1/1n4r1/2P1b2B/p3N2p/P2Q3P/8/1R3R1K w - - 2 39",
+
+        "6RR/4bP2/8/8/5r2/3K4/5p2/4k3 w - - 0 1",                       // SEE test suite - regular promotion
+        "1n2kb1r/p1P4p/2qb4/5pP1/4n2Q/8/PP1PPP1P/RNB1KBNR w KQk - 0 1", // SEE test suite - promotion with capture
+        "6Q1/8/1kp4P/2q1p3/2PpP3/2nP2P1/p7/5BK1 b - - 1 35",            // Fischer vs Petrosian - double promotion
+        "5R2/2k3PK/8/5N2/7P/5q2/8/q7 w - - 0 69",                       // McShane - Aronian 2012 - knight promotion
+        "rnbqk1nr/ppp2ppp/8/4P3/1BP5/8/PP2KpPP/RN1Q1BNR b kq - 1 7",    // Albin Countergambit, Lasker Trap - knight promotion
+
+        "8/nRp5/8/8/8/7k/8/7K w - - 0 1",                               // R vs NP
+        "8/bRp5/8/8/8/7k/8/7K w - - 0 1",                               // R vs BP
+        "8/8/4k3/3n1n2/5P2/8/3K4/8 b - - 0 12",                         // NN vs P endgame
+        "8/bQr5/8/8/8/7k/8/7K w - - 0 1",                               // Q vs RB, leading to Q vs R or Q vs B
+        "8/nQr5/8/8/8/7k/8/7K w - - 0 1",                               // Q vs RN, leading to Q vs R or Q vs N
+        "4kq2/8/n7/8/8/3Q3b/8/3K4 w - - 0 1",                           // Q vs QBN, leading to Q vs QB or Q vs QN
+        "8/5R2/1n2RK2/8/8/7k/4r3/8 b - - 0 1",                          // RR vs RN endgame, where if black takes, they actually loses
+        "8/n3p3/8/2B5/2b5/7k/P7/7K w - - 0 1",                          // BP vs BNP endgame, leading to B vs BN
+        "8/n3p3/8/2B5/1n6/7k/P7/7K w - - 0 1",                          // BP vs NNP endgame, leading to B vs NN
+        "8/bRn5/8/7b/8/7k/8/7K w - - 0 1",                              // R vs BBN, leading to R vs BN or R vs BB
+        "1b6/1R1r4/8/1n6/7k/8/8/7K w - - 0 1",                          // R vs RBN, leading to R vs BN or R vs RB or R vs RN
+        "8/q5rk/8/8/8/8/Q5RK/7N w - - 0 1",                             // Endgame that can lead to QN vs Q or RN vs R positions
+        "1kr5/2bp3q/Q7/1K6/6q1/6B1/8/8 w - - 0 1",                      // Endgame where triple repetition can and needs to be forced by white
+        "1kr5/2bp3q/R7/1K6/6q1/6B1/8/8 w - - 96 200",                    // Endgame where 50 moves draw can and needs to be forced by white
+        "rnbqk2r/pppp1ppp/5n2/8/Bb2N3/8/PPPPQPPP/RNB1K2R w KQkq - 2 1", // Petroff defense alike position with double check Q and N
+        "rnb1kb1r/pppp1ppp/5n2/8/4N3/8/PPPP1PPP/RNB1R1K1 w kq - 2 5",   // Double check R and N
+        "rnbqk2r/ppp2ppp/3p4/8/1b2Bn2/8/PPPPQPPP/RNB1K2R w KQkq - 2 5", // Double check Q and B
+        "rnbqk2r/ppp2ppp/3p4/8/1b2B3/3n4/PPPP1PPP/RNBQR1K1 w kq - 2 5", // Double check R and B
+        "r3k2r/ppp2ppp/n7/1N1p4/Bb6/8/PPPP1PPP/RNBQ1RK1 w kq - 2 1",    // Double check B and N, castling rights
+        "r3k2r/ppp2ppp/n7/1N1p4/Bb6/8/PPPP1PPP/RNBQ1RK1 w - - 2 1",     // Double check B and N, no castling rights
+};
+
+std::vector<std::string> load_bench_fens(const std::string & file)
+{
+	if (file.empty())
+		return bench_fens;
+
+	std::vector<std::string> out;
+
+	std::ifstream fh(file);
+	std::string   line;
+	while(std::getline(fh, line)) {
+		if (line.empty() == false && line[0] != '#')
+			out.push_back(line);
+	}
+
+	return out;
+}
+
+std::vector<bench_result_t> bench_positions(const std::vector<std::string> & fens, const int depth, const bool show_progress, uint64_t *const signature)
+{
+	std::vector<bench_result_t> out;
+
+	for(auto & fen: fens) {
+		if (show_progress) {
+			printf("\33[2K\r%s\r", fen.c_str());
+			fflush(stdout);
+		}
+
+		reset_search_statistics();
+
+		sp.at(0)->pos = libchess::Position(fen);
+		for(auto & i: sp)
+			memset(i->history, 0x00, history_malloc_size);
+		prepare_threads_state();
+
+		uint64_t start_ts = esp_timer_get_time();
+		start_search(-1, true, depth, { }, false);
+		auto [ best_move, best_score ] = wait_search_finished();
+		uint64_t end_ts   = esp_timer_get_time();
+
+		if (signature)
+			*signature = search_signature(*signature, best_move, best_score);
+
+		chess_stats cs = calculate_search_statistics();
+
+		bench_result_t result;
+		result.fen         = fen;
+		result.nodes       = simple_search_statistics().first;
+		result.us          = std::max(uint64_t(1), end_ts - start_ts);
+		result.best_move   = best_move.to_str();
+		result.tt_hit_rate = cs.data.tt_query ? cs.data.tt_hit / double(cs.data.tt_query) : 0.;
+		out.push_back(result);
+	}
+
+	if (show_progress)
+		printf("\33[2K\r");
+
+	return out;
+}
+
+static std::pair<uint64_t, uint64_t> bench_totals(const std::vector<bench_result_t> & results)
+{
+	uint64_t nodes = 0;
+	uint64_t us    = 0;
+	for(auto & r: results) {
+		nodes += r.nodes;
+		us    += r.us;
+	}
+
+	return { nodes, std::max(uint64_t(1), us) };
+}
+
+static void emit_json(const std::vector<bench_result_t> & results, const bench_parameters_t & pars, const uint64_t signature)
+{
+	auto [ node_count, t_diff ] = bench_totals(results);
+
+	printf("{\n");
+	printf("  \"depth\": %d, \"threads\": %d, \"hash\": %d, \"smp_mode\": \"%s\", \"deterministic\": %s,\n", pars.depth, pars.n_threads, tti.get_size(), smp_mode_name(smp_mode), deterministic ? "true" : "false");
+	printf("  \"nodes\": %" PRIu64 ", \"time_us\": %" PRIu64 ", \"nps\": %" PRIu64 ", \"signature\": \"%016" PRIx64 "\",\n", node_count, t_diff, node_count * 1000000 / t_diff, signature);
+	printf("  \"positions\": [\n");
+	for(size_t i=0; i<results.size(); i++) {
+		auto & r = results[i];
+		// one position per line, see load_json_results()
+		printf("    { \"fen\": \"%s\", \"nodes\": %" PRIu64 ", \"time_us\": %" PRIu64 ", \"nps\": %" PRIu64 ", \"bestmove\": \"%s\", \"tt_hit_rate\": %.4f }%s\n",
+				r.fen.c_str(), r.nodes, r.us, r.nodes * 1000000 / r.us, r.best_move.c_str(), r.tt_hit_rate, i + 1 < results.size() ? "," : "");
+	}
+	printf("  ]\n");
+	printf("}\n");
+}
+
+void run_bench(const bench_parameters_t & pars)
+{
+	init_lmr();
+	init_material_table();
+
+	auto fens = load_bench_fens(pars.fen_file);
+	if (fens.empty()) {
+		printf("No positions in %s\n", pars.fen_file.c_str());
+		return;
+	}
+
+	// the messages of the threads go to stderr so that stdout is valid JSON
+	int json_fd = -1;
+	if (pars.json) {
+		fflush(stdout);
+		json_fd = dup(1);
+		dup2(2, 1);
+	}
+
+	if (pars.hash_mb > 0)
+		tti.set_size(uint64_t(pars.hash_mb) * 1024 * 1024);
+	allocate_threads(pars.n_threads);
+
+	uint64_t signature = fnv_offset_basis;
+	auto results = bench_positions(fens, pars.depth, !pars.json, &signature);
+
+	delete_threads();
+
+	if (pars.json) {
+		fflush(stdout);
+		dup2(json_fd, 1);
+		close(json_fd);
+
+		emit_json(results, pars, signature);
+	}
+	else {
+		auto [ node_count, t_diff ] = bench_totals(results);
+
+		printf("===========================\n");
+		printf("Total time (ms) : %" PRIu64 "\n", t_diff / 1000);
+		printf("Nodes searched  : %" PRIu64 "\n", node_count);
+		printf("Nodes/second    : %" PRIu64 "\n", node_count * 1000000 / t_diff);
+		if (deterministic)
+			printf("Signature       : %016" PRIx64 "\n", signature);
+	}
+}
+
+// NPS and time-to-depth for an increasing number of threads, for each of the SMP modes
+// (speedups are relative to 1 thread of the same mode)
+void run_bench_scaling(const bench_parameters_t & pars, const std::vector<smp_mode_t> & modes)
+{
+	init_lmr();
+	init_material_table();
+
+	auto fens = load_bench_fens(pars.fen_file);
+
+	if (pars.hash_mb > 0)
+		tti.set_size(uint64_t(pars.hash_mb) * 1024 * 1024);
+
+	smp_mode_t original_mode = smp_mode;
+
+	for(auto mode : modes) {
+		smp_mode = mode;
+
+		printf("SMP mode %s, depth %d\n", smp_mode_name(mode), pars.depth);
+		printf("threads  time (ms)      nodes        nps  nps speedup  ttd speedup\n");
+
+		uint64_t base_time = 0;
+		uint64_t base_nps  = 0;
+
+		for(int n=1; n<=pars.n_threads; n *= 2) {
+			allocate_threads(n);
+			tti.reset();
+
+			auto [ node_count, t_diff ] = bench_totals(bench_positions(fens, pars.depth, false, nullptr));
+
+			uint64_t nps = node_count * 1000000 / t_diff;
+			if (n == 1) {
+				base_time = t_diff;
+				base_nps  = std::max(uint64_t(1), nps);
+			}
+
+			printf("%7d %10" PRIu64 " %10" PRIu64 " %10" PRIu64 " %12.2f %12.2f\n", n, t_diff / 1000, node_count, nps, double(nps) / base_nps, double(base_time) / t_diff);
+		}
+	}
+
+	smp_mode = original_mode;
+
+	delete_threads();
+}
+
+static std::optional<double> json_number(const std::string & line, const std::string & key)
+{
+	size_t pos = line.find("\"" + key + "\": ");
+	if (pos == std::string::npos)
+		return { };
+
+	return atof(line.c_str() + pos + key.size() + 4);
+}
+
+// only reads what emit_json() writes
+static std::vector<bench_result_t> load_json_results(const std::string & file)
+{
+	std::vector<bench_result_t> out;
+
+	std::ifstream fh(file);
+	std::string   line;
+	while(std::getline(fh, line)) {
+		if (line.find("\"fen\": ") == std::string::npos)
+			continue;
+
+		auto nodes = json_number(line, "nodes");
+		auto us    = json_number(line, "time_us");
+		if (nodes.has_value() == false || us.has_value() == false)
+			continue;
+
+		bench_result_t result;
+		size_t fen_start = line.find("\"fen\": \"") + 8;
+		result.fen   = line.substr(fen_start, line.find('"', fen_start) - fen_start);
+		result.nodes = nodes.value();
+		result.us    = std::max(1., us.value());
+		out.push_back(result);
+	}
+
+	return out;
+}
+
+// two-sided, 95%
+static double t_critical(const int df)
+{
+	static const double table[] { 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+		2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+		2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042 };
+
+	if (df >= 1 && df <= 30)
+		return table[df - 1];
+
+	return 1.96;
+}
+
+// paired t-test over the positions on the relative change (new / old - 1)
+static void compare_metric(const char *const name, const std::vector<double> & old_values, const std::vector<double> & new_values)
+{
+	size_t n = old_values.size();
+
+	std::vector<double> diffs;
+	double old_sum = 0;
+	double new_sum = 0;
+	for(size_t i=0; i<n; i++) {
+		diffs.push_back(old_values[i] > 0 ? new_values[i] / old_values[i] - 1. : 0.);
+		old_sum += old_values[i];
+		new_sum += new_values[i];
+	}
+
+	double mean = 0;
+	for(auto d: diffs)
+		mean += d;
+	mean /= n;
+
+	double sd = 0;
+	for(auto d: diffs)
+		sd += (d - mean) * (d - mean);
+	sd = n > 1 ? sqrt(sd / (n - 1)) : 0;
+
+	double t           = sd > 0 ? mean / (sd / sqrt(n)) : (mean != 0 ? INFINITY : 0);
+	bool   significant = n > 1 && fabs(t) > t_critical(n - 1);
+
+	printf("%-6s old %14.0f new %14.0f  mean change per position %+7.2f%%  t %8.2f  %s\n", name, old_sum / n, new_sum / n, mean * 100, t,
+			significant ? (mean < 0 ? "SIGNIFICANT DECREASE" : "SIGNIFICANT INCREASE") : "no significant change");
+}
+
+int run_bench_compare(const std::string & old_file, const std::string & new_file)
+{
+	auto old_results = load_json_results(old_file);
+	auto new_results = load_json_results(new_file);
+
+	std::vector<double> old_nps, new_nps, old_nodes, new_nodes;
+	int n_nodes_differ = 0;
+
+	for(auto & o: old_results) {
+		auto it = std::find_if(new_results.begin(), new_results.end(), [&o](const bench_result_t & r) { return r.fen == o.fen; });
+		if (it == new_results.end())
+			continue;
+
+		old_nps.push_back(o.nodes * 1000000. / o.us);
+		new_nps.push_back(it->nodes * 1000000. / it->us);
+		old_nodes.push_back(o.nodes);
+		new_nodes.push_back(it->nodes);
+		n_nodes_differ += o.nodes != it->nodes;
+	}
+
+	if (old_nps.empty()) {
+		printf("No common positions in %s and %s\n", old_file.c_str(), new_file.c_str());
+		return 1;
+	}
+
+	printf("%zu positions, node count differs for %d of them\n", old_nps.size(), n_nodes_differ);
+	compare_metric("nps",   old_nps,   new_nps  );
+	compare_metric("nodes", old_nodes, new_nodes);
+
+	return 0;
+}
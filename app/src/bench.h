@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "search.h"
+
+
+typedef struct {
+	int         depth     { 10    };
+	int         n_threads { 1     };
+	int         hash_mb   { 0     };  // 0: keep the current size
+	std::string fen_file;             // empty: the built-in positions
+	bool        json      { false };
+} bench_parameters_t;
+
+typedef struct {
+	std::string fen;
+	uint64_t    nodes;
+	uint64_t    us;
+	std::string best_move;
+	double      tt_hit_rate;
+} bench_result_t;
+
+std::vector<std::string>    load_bench_fens(const std::string & file);
+std::vector<bench_result_t> bench_positions(const std::vector<std::string> & fens, const int depth, const bool show_progress, uint64_t *const signature);
+
+void run_bench        (const bench_parameters_t & pars);
+void run_bench_scaling(const bench_parameters_t & pars, const std::vector<smp_mode_t> & modes);
+int  run_bench_compare(const std::string & old_file, const std::string & new_file);
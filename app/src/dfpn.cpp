@@ -0,0 +1,240 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <tuple>
+#include <vector>
+#include <libchess/Position.h>
+
+#include "dfpn.h"
+
+
+// see https://www.chessprogramming.org/Proof-Number_Search#Depth-First_Proof-Number_Search
+constexpr uint32_t pn_inf = 100000000;
+
+static uint32_t pn_add(const uint32_t a, const uint32_t b)
+{
+	return std::min(pn_inf, a + b);
+}
+
+dfpn::dfpn(end_t *const stop, const uint64_t size) :
+	n_entries(size / sizeof(pn_entry)),
+	stop(stop)
+{
+	entries = reinterpret_cast<pn_entry *>(malloc(n_entries * sizeof(pn_entry)));
+	reset();
+}
+
+dfpn::~dfpn()
+{
+	free(entries);
+}
+
+void dfpn::reset()
+{
+	memset(entries, 0x00, n_entries * sizeof(pn_entry));
+	nodes = 0;
+}
+
+uint64_t dfpn::get_node_count() const
+{
+	return nodes;
+}
+
+end_t *dfpn::get_stop() const
+{
+	return stop;
+}
+
+// a proof found with fewer plies left is also valid when more are available, for
+// a disproof it is the other way around; anything else must match exactly
+std::pair<uint32_t, uint32_t> dfpn::lookup(const uint64_t hash, const int depth_left) const
+{
+	const pn_entry & e = entries[hash % n_entries];
+
+	if (e.hash == hash && (e.pn != 0 || e.dn != 0)) {
+		if (e.depth_left == depth_left)
+			return { e.pn, e.dn };
+		if (e.pn == 0 && e.depth_left <= depth_left)
+			return { 0, pn_inf };
+		if (e.dn == 0 && e.depth_left >= depth_left)
+			return { pn_inf, 0 };
+	}
+
+	return { 1, 1 };
+}
+
+void dfpn::store(const uint64_t hash, const uint32_t pn, const uint32_t dn, const int depth_left)
+{
+	pn_entry & e = entries[hash % n_entries];
+	e.hash       = hash;
+	e.pn         = pn;
+	e.dn         = dn;
+	e.depth_left = depth_left;
+}
+
+// or_node: attacker to move; depth_left: number of plies the attacker still has
+void dfpn::mid(libchess::Position & pos, const uint32_t th_pn, const uint32_t th_dn, const int depth_left, const bool or_node)
+{
+	nodes++;
+
+	const uint64_t hash       = pos.hash();
+	auto           move_list  = pos.legal_move_list();
+	size_t         n_children = move_list.size();
+
+	if (n_children == 0) {
+		if (!or_node && pos.in_check())
+			store(hash, 0, pn_inf, depth_left);  // mate
+		else
+			store(hash, pn_inf, 0, depth_left);  // stalemate or attacker got mated
+		return;
+	}
+
+	if (depth_left == 0) {
+		store(hash, pn_inf, 0, depth_left);
+		return;
+	}
+
+	// child hashes are needed every round, calculate them once
+	std::vector<libchess::Move> children;
+	std::vector<uint64_t>       child_hashes;
+	std::vector<bool>           child_is_draw;
+	children.reserve(n_children);
+	child_hashes.reserve(n_children);
+	child_is_draw.reserve(n_children);
+
+	for(auto move : move_list) {
+		pos.make_move(move);
+		children.push_back(move);
+		child_hashes.push_back(pos.hash());
+		child_is_draw.push_back(pos.is_repeat() || pos.halfmoves() >= 100);
+		pos.unmake_move();
+	}
+
+	for(;;) {
+		uint32_t pn        = or_node ? pn_inf : 0;
+		uint32_t dn        = or_node ? 0 : pn_inf;
+		size_t   best      = 0;
+		uint32_t best_pn   = pn_inf;
+		uint32_t best_dn   = pn_inf;
+		uint32_t second    = pn_inf;
+
+		for(size_t i=0; i<n_children; i++) {
+			uint32_t c_pn = pn_inf;
+			uint32_t c_dn = 0;
+			if (child_is_draw[i] == false)
+				std::tie(c_pn, c_dn) = lookup(child_hashes[i], depth_left - 1);
+
+			if (or_node) {
+				pn = std::min(pn, c_pn);
+				dn = pn_add(dn, c_dn);
+
+				if (c_pn < best_pn) {
+					second  = best_pn;
+					best    = i;
+					best_pn = c_pn;
+					best_dn = c_dn;
+				}
+				else if (c_pn < second) {
+					second  = c_pn;
+				}
+			}
+			else {
+				pn = pn_add(pn, c_pn);
+				dn = std::min(dn, c_dn);
+
+				if (c_dn < best_dn) {
+					second  = best_dn;
+					best    = i;
+					best_pn = c_pn;
+					best_dn = c_dn;
+				}
+				else if (c_dn < second) {
+					second  = c_dn;
+				}
+			}
+		}
+
+		if (pn >= th_pn || dn >= th_dn || stop->flag) {
+			if (stop->flag == false)
+				store(hash, pn, dn, depth_left);
+			return;
+		}
+
+		uint32_t c_th_pn = 0;
+		uint32_t c_th_dn = 0;
+		if (or_node) {
+			c_th_pn = std::min(th_pn, pn_add(second, 1));
+			c_th_dn = pn_add(th_dn - dn, best_dn);
+		}
+		else {
+			c_th_pn = pn_add(th_pn - pn, best_pn);
+			c_th_dn = std::min(th_dn, pn_add(second, 1));
+		}
+
+		pos.make_move(children[best]);
+		mid(pos, c_th_pn, c_th_dn, depth_left - 1, !or_node);
+		pos.unmake_move();
+	}
+}
+
+std::optional<libchess::Move> dfpn::get_proving_move(libchess::Position & pos, const int depth_left)
+{
+	for(auto move : pos.legal_move_list()) {
+		pos.make_move(move);
+		bool proven = pos.is_repeat() == false && lookup(pos.hash(), depth_left - 1).first == 0;
+		pos.unmake_move();
+
+		if (proven)
+			return move;
+	}
+
+	return { };
+}
+
+std::optional<std::pair<libchess::Move, int> > dfpn::solve(libchess::Position & pos, const int max_mate_moves)
+{
+	// iterate over the mate distance so that the shortest mate is found
+	for(int mate_moves=1; mate_moves<=std::min(max_mate_moves, dfpn_max_mate_moves); mate_moves++) {
+		int depth_left = mate_moves * 2 - 1;
+
+		mid(pos, pn_inf, pn_inf, depth_left, true);
+
+		if (stop->flag)
+			break;
+
+		if (lookup(pos.hash(), depth_left).first == 0) {
+			auto move = get_proving_move(pos, depth_left);
+			if (move.has_value())
+				return { { move.value(), mate_moves } };
+		}
+	}
+
+	return { };
+}
+
+std::vector<libchess::Move> dfpn::get_pv(const libchess::Position & pos_in, const int mate_moves)
+{
+	auto work = pos_in;
+
+	std::vector<libchess::Move> out;
+
+	for(int depth_left = mate_moves * 2 - 1; depth_left > 0; depth_left--) {
+		std::optional<libchess::Move> move;
+
+		if (depth_left & 1)  // attacker
+			move = get_proving_move(work, depth_left);
+		else {
+			auto move_list = work.legal_move_list();
+			if (move_list.size())
+				move = *move_list.begin();
+		}
+
+		if (move.has_value() == false)
+			break;
+
+		out.push_back(move.value());
+		work.make_move(move.value());
+	}
+
+	return out;
+}
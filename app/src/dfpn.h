@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+#include <libchess/Position.h>
+
+#include "main.h"
+
+
+// depth-first proof-number search, only used for finding (forced) mates
+typedef struct
+{
+	uint64_t hash;
+	uint32_t pn;
+	uint32_t dn;
+	uint8_t  depth_left;
+} pn_entry;
+
+class dfpn
+{
+private:
+	pn_entry   *entries   { nullptr };
+	uint64_t    n_entries { 0       };
+	end_t      *const stop;
+	uint64_t    nodes     { 0       };
+
+	std::pair<uint32_t, uint32_t> lookup(const uint64_t hash, const int depth_left) const;
+	void store(const uint64_t hash, const uint32_t pn, const uint32_t dn, const int depth_left);
+	void mid(libchess::Position & pos, const uint32_t th_pn, const uint32_t th_dn, const int depth_left, const bool or_node);
+	std::optional<libchess::Move> get_proving_move(libchess::Position & pos, const int depth_left);
+
+public:
+	dfpn(end_t *const stop, const uint64_t size);
+	~dfpn();
+
+	void     reset();
+	uint64_t get_node_count() const;  // since the construction or the last reset()
+	end_t   *get_stop() const;
+
+	// returns the mating move and the number of moves to mate
+	std::optional<std::pair<libchess::Move, int> > solve(libchess::Position & pos, const int max_mate_moves);
+	std::vector<libchess::Move> get_pv(const libchess::Position & pos_in, const int mate_moves);
+};
+
+constexpr int dfpn_max_mate_moves = 64;
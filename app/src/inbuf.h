@@ -1,7 +1,15 @@
 #pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <cstdio>
 #include <cstring>
 #include <streambuf>
+#if defined(linux) || defined(__ANDROID__) || defined(__APPLE__)
+#include <cerrno>
+#include <poll.h>
+#include <unistd.h>
+#endif
 
 #if defined(ESP32)
 #include <driver/gpio.h>
@@ -13,19 +21,28 @@
 #include <freertos/task.h>
 
 const int uart_num = UART_NUM_2;
+#else
+uint64_t esp_timer_get_time();
 #endif
 
 
 // http://www.josuttis.com/libbook/io/inbuf1.hpp.html
-constexpr int bufferSize { 10 };    // size of the data buffer
+constexpr int bufferSize { 4 + 4096 };  // size of the data buffer
 class inbuf : public std::streambuf {
 protected:
 	/* data buffer:
 	 * - at most, four characters in putback area plus
-	 * - at most, six characters in ordinary read buffer
+	 * - what one read returned (normally one or more complete lines)
 	 */
 	char buffer[bufferSize];            // data buffer
 	bool local_echo { false };
+#if defined(linux) || defined(__ANDROID__) || defined(__APPLE__)
+	int  wakeup_pipe[2] { -1, -1 };
+#endif
+
+	// arrival of the first character of the current command line
+	std::atomic<uint64_t> line_start_ts { 0    };
+	bool                  at_line_start { true };
 
 public:
 	/* constructor
@@ -37,12 +54,29 @@ public:
 		setg (buffer+4,     // beginning of putback area
 			buffer+4,     // read position
 			buffer+4);    // end position
+#if defined(linux) || defined(__ANDROID__) || defined(__APPLE__)
+		if (pipe(wakeup_pipe) == -1)
+			wakeup_pipe[0] = wakeup_pipe[1] = -1;
+#endif
 	}
 
+#if defined(linux) || defined(__ANDROID__) || defined(__APPLE__)
+	// a blocked reader returns end-of-file; async-signal-safe
+	void wakeup() {
+		char c = 0;
+		if (write(wakeup_pipe[1], &c, 1) == -1) {
+		}
+	}
+#endif
+
 	void set_local_echo(const bool state) {
 		local_echo = state;
 	}
 
+	uint64_t get_line_start_ts() const {
+		return line_start_ts;
+	}
+
 	void echo(const int c) {
 		if (local_echo) {
 #if defined(ESP32)
@@ -77,40 +111,66 @@ protected:
 				numPutback);
 
 		// read new characters
-		int c = 0;
+		int num = 0;
+#if defined(linux) || defined(__ANDROID__) || defined(__APPLE__)
+		for(;;) {
+			pollfd fds[] { { 0, POLLIN, 0 }, { wakeup_pipe[0], POLLIN, 0 } };
+			if (poll(fds, wakeup_pipe[0] == -1 ? 1 : 2, -1) == -1) {
+				if (errno == EINTR)
+					continue;
+				return traits_type::eof();
+			}
+
+			if (fds[1].revents)
+				return traits_type::eof();
+
+			num = read(0, buffer + 4, bufferSize - 4);
+			if (num == -1 && errno == EINTR)
+				continue;
+			if (num <= 0)
+				return traits_type::eof();
+			break;
+		}
+
+		for(int j=0; j<num; j++)
+			echo(buffer[4 + j]);
+#elif defined(_WIN32)
+		if (!fgets(buffer + 4, bufferSize - 4, stdin))
+			return traits_type::eof();
+		num = strlen(buffer + 4);
 
+		for(int j=0; j<num; j++)
+			echo(buffer[4 + j]);
+#else
 		for(;;) {
-			c = fgetc(stdin);
+			int c = fgetc(stdin);
 			if (c >= 0) {
 				echo(c);
+				buffer[4] = c;
+				num = 1;
 				break;
 			}
 
-#if !defined(linux) && !defined(_WIN32) && !defined(__ANDROID__) && !defined(__APPLE__)
-			int length = 0;
-			ESP_ERROR_CHECK(uart_get_buffered_data_len(uart_num, (size_t*)&length));
-			if (length) {
-				char buffer = 0;
-				if (uart_read_bytes(uart_num, &buffer, 1, 100)) {
-					if (buffer == 13) {
+			// wait (one tick at most) for the first byte, then take everything that arrived
+			size_t length = 0;
+			ESP_ERROR_CHECK(uart_get_buffered_data_len(uart_num, &length));
+			num = uart_read_bytes(uart_num, buffer + 4, std::clamp(length, size_t(1), size_t(bufferSize - 4)), 1);
+			if (num > 0) {
+				for(int j=0; j<num; j++) {
+					if (buffer[4 + j] == 13) {
 						echo(13);
-						c = 10;
-					}
-					else {
-						c = buffer;
+						buffer[4 + j] = 10;
 					}
-					echo(c);
-					break;
+					echo(buffer[4 + j]);
 				}
+				break;
 			}
-
-			vTaskDelay(1);
-#endif
 		}
+#endif
 
-		buffer[4] = c;
-
-		int num = 1;
+		if (at_line_start)
+			line_start_ts = esp_timer_get_time();
+		at_line_start = buffer[4 + num - 1] == '\n';
 
 		// reset buffer pointers
 		setg (buffer+(4-numPutback),   // beginning of putback area
@@ -0,0 +1,99 @@
+#include <atomic>
+#include <cinttypes>
+#include <cstdio>
+
+#include "latency.h"
+
+
+// bucket n counts durations of 2^(n-1) up to 2^n microseconds (bucket 0: < 1 us)
+constexpr int n_latency_buckets = 32;
+
+static const char *const latency_names[LATENCY_N] = { "input", "search start", "last iteration", "stop->bestmove", "overrun" };
+
+static struct {
+	std::atomic<uint32_t> buckets[n_latency_buckets];
+	std::atomic<uint64_t> n;
+	std::atomic<uint64_t> sum;
+	std::atomic<uint64_t> max;
+} histograms[LATENCY_N];
+
+static int bucket_of(uint64_t us)
+{
+	int bucket = 0;
+	while(us && bucket < n_latency_buckets - 1) {
+		us >>= 1;
+		bucket++;
+	}
+
+	return bucket;
+}
+
+void latency_add(const latency_kind_t kind, const uint64_t us)
+{
+	auto & h = histograms[kind];
+
+	h.buckets[bucket_of(us)]++;
+	h.n++;
+	h.sum += us;
+
+	uint64_t cur_max = h.max;
+	while(us > cur_max && !h.max.compare_exchange_weak(cur_max, us)) {
+	}
+}
+
+void latency_reset()
+{
+	for(auto & h: histograms) {
+		for(auto & b: h.buckets)
+			b = 0;
+		h.n   = 0;
+		h.sum = 0;
+		h.max = 0;
+	}
+}
+
+uint64_t latency_count(const latency_kind_t kind)
+{
+	return histograms[kind].n;
+}
+
+uint64_t latency_sum(const latency_kind_t kind)
+{
+	return histograms[kind].sum;
+}
+
+uint64_t latency_percentile(const latency_kind_t kind, const double p)
+{
+	auto    &h     = histograms[kind];
+	uint64_t limit = h.n * p;
+	uint64_t seen  = 0;
+
+	for(int i=0; i<n_latency_buckets; i++) {
+		seen += h.buckets[i];
+		if (seen > limit)
+			return uint64_t(1) << i;
+	}
+
+	return h.max;
+}
+
+void latency_dump()
+{
+	for(int kind=0; kind<LATENCY_N; kind++) {
+		auto & h = histograms[kind];
+		uint64_t n = h.n;
+
+		printf("# %-15s n: %" PRIu64, latency_names[kind], n);
+		if (n == 0) {
+			printf("\n");
+			continue;
+		}
+
+		printf(", avg: %" PRIu64 " us, p50: <%" PRIu64 " us, p99: <%" PRIu64 " us, max: %" PRIu64 " us\n", h.sum / n, latency_percentile(latency_kind_t(kind), 0.5), latency_percentile(latency_kind_t(kind), 0.99), uint64_t(h.max));
+
+		for(int i=0; i<n_latency_buckets; i++) {
+			if (h.buckets[i])
+				printf("#   < %10" PRIu64 " us: %u\n", uint64_t(1) << i, unsigned(h.buckets[i]));
+		}
+	}
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdint>
+
+
+// where the time between a UCI command and our answer goes, see the "latency" command
+typedef enum {
+	LATENCY_INPUT,           // first byte of a command line -> its handler is invoked
+	LATENCY_SEARCH_START,    // go -> first node searched
+	LATENCY_LAST_ITERATION,  // end of the last completed iteration -> stop (discarded work)
+	LATENCY_BESTMOVE,        // stop -> bestmove flushed
+	LATENCY_OVERRUN,         // go -> bestmove flushed, minus the think time (when positive)
+	LATENCY_N
+} latency_kind_t;
+
+void latency_add(const latency_kind_t kind, const uint64_t us);
+void latency_reset();
+void latency_dump();
+
+uint64_t latency_count(const latency_kind_t kind);
+uint64_t latency_sum(const latency_kind_t kind);  // us
+// upper bound (us) of the histogram bucket in which the percentile falls
+uint64_t latency_percentile(const latency_kind_t kind, const double p);
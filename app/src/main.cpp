@@ -9,6 +9,7 @@
 #include <cstdio>
 #include <cstring>
 #include <iostream>
+#include <map>
 #include <mutex>
 #include <signal.h>
 #include <streambuf>
@@ -48,11 +49,21 @@
 #include <libchess/Position.h>
 #include <libchess/UCIService.h>
 
+#if defined(linux) || defined(_WIN32) || defined(__APPLE__)
+#include "affinity.h"
+#include "dfpn.h"
+#endif
+#include "bench.h"
 #include "eval.h"
 #include "inbuf.h"
+#include "latency.h"
 #include "main.h"
 #include "max-ascii.h"
+#include "metrics.h"
+#include "microbench.h"
 #include "nnue.h"
+#include "output.h"
+#include "perft.h"
 #include "psq.h"
 #include "search.h"
 #include "str.h"
@@ -61,6 +72,9 @@
 bool with_syzygy = false;
 #endif
 #include "test.h"
+#include "timemanager.h"
+#include "tracelog.h"
+#include "treerec.h"
 #include "tt.h"
 #include "tui.h"
 
@@ -70,8 +84,8 @@ std::vector<search_pars_t *> sp;
 std::thread *usb_disp_thread { nullptr };
 
 #if defined(linux) || defined(__APPLE__)
-uint64_t wboard { 0 };
-uint64_t bboard { 0 };
+std::atomic<uint64_t> wboard { 0 };
+std::atomic<uint64_t> bboard { 0 };
 #endif
 
 #if defined(linux) || defined(_WIN32) || defined(__APPLE__)
@@ -92,26 +106,10 @@ void my_trace(const char *const fmt, ...)
 	}
 #if !defined(ESP32)
 	if (my_trace_file.empty() == false) {
-		FILE *fh = fopen(my_trace_file.c_str(), "a+");
-		if (fh) {
-			uint64_t now = esp_timer_get_time();  // is gettimeofday
-			time_t t = now / 1000000;
-			tm *tm = localtime(&t);
-			fprintf(fh, "[%d] %04d-%02d-%02d %02d:%02d:%02d.%06d ", getpid(),
-					tm->tm_year + 1900, tm->tm_mon + 1, tm->tm_mday,
-					tm->tm_hour, tm->tm_min, tm->tm_sec,
-					now % 1000000);
-
-			va_list ap { };
-			va_start(ap, fmt);
-			vfprintf(fh, fmt, ap);
-			va_end(ap);
-
-			fclose(fh);
-		}
-		else {
-			fprintf(stderr, "Cannot access %s: %s\n", my_trace_file.c_str(), strerror(errno));
-		}
+		va_list ap { };
+		va_start(ap, fmt);
+		trace_log_add(fmt, ap);
+		va_end(ap);
 	}
 #endif
 }
@@ -129,10 +127,54 @@ void clear_flag(end_t *const stop)
 	stop->flag = false;
 }
 
+// from the arrival of the command line up to its handler
+static void record_input_latency(const uint64_t handler_ts)
+{
+	uint64_t line_start_ts = i.get_line_start_ts();
+
+	if (line_start_ts && handler_ts >= line_start_ts)
+		latency_add(LATENCY_INPUT, handler_ts - line_start_ts);
+}
+
+// "go ponder": no bestmove may be sent before "ponderhit" or "stop" was received
+struct {
+	std::mutex              lock;
+	std::condition_variable cv;
+	bool                    active     { false };
+	int                     think_time { 0     };
+	bool                    is_abs     { false };
+	bool                    hit        { false };  // ended by a ponderhit (at hit_ts)
+	uint64_t                hit_ts     { 0     };
+} ponder_go;
+
+static void end_ponder_go(const bool is_hit)
+{
+	std::unique_lock<std::mutex> lck(ponder_go.lock);
+
+	if (ponder_go.active) {
+		if (is_hit)
+			ponderhit(ponder_go.think_time, ponder_go.is_abs);
+		metrics_ponder_end(is_hit);
+
+		ponder_go.hit    = is_hit;
+		ponder_go.hit_ts = esp_timer_get_time();
+
+		ponder_go.active = false;
+		ponder_go.cv.notify_all();
+	}
+}
+
 auto stop_handler = []()
 {
+	record_input_latency(esp_timer_get_time());
+
+	end_ponder_go(false);
+
+	record_stop_request();
+
 	for(auto & i: sp)
 		set_flag(i->stop);
+	root_split_wakeup();
 #if !defined(__ANDROID__)
 	my_trace("# stop_handler invoked\n");
 #endif
@@ -240,9 +282,10 @@ std::istream is(&i);
 // TODO replace by messages
 struct {
 	std::mutex              search_fen_lock;
-	bool                    reconfigure_threads  { false };
+	std::atomic_bool        reconfigure_threads  { false };
 	std::condition_variable search_cv;
-	int                     search_version       { -1    };
+	std::atomic_int         search_version       { -1    };
+	int                     n_sleeping           { 0     };
 	int                     search_think_time    { 0     };
 	bool                    search_is_abs_time   { false };
 	int                     search_max_depth;
@@ -251,19 +294,119 @@ struct {
 	libchess::Move          search_best_move     { 0     };
 	int                     search_best_score    { 0     };
 	bool                    search_output        { false };
-	int                     search_count_running { 0     };
+	std::atomic_int         search_count_pending { 0     };  // threads that did not finish the current search yet
+	std::atomic_bool        search_finished      { false };
 } work;
 
+// go -> first node and stop -> bestmove, in microseconds
+struct {
+	std::atomic<uint64_t> go_ts            { 0 };
+	std::atomic<uint64_t> first_node_ts    { 0 };
+	std::atomic<uint64_t> iteration_end_ts { 0 };
+	std::atomic<uint64_t> stop_ts          { 0 };
+} search_latency;
+
+void record_first_node()
+{
+	uint64_t expected = 0;
+	search_latency.first_node_ts.compare_exchange_strong(expected, esp_timer_get_time());
+}
+
+void record_iteration_end()
+{
+	search_latency.iteration_end_ts = esp_timer_get_time();
+}
+
+// only the first stop request (stop command, timer or end of search) counts
+void record_stop_request()
+{
+	uint64_t expected = 0;
+	search_latency.stop_ts.compare_exchange_strong(expected, esp_timer_get_time());
+}
+
+void trace_search_latency(const uint64_t bestmove_ts)
+{
+	uint64_t go_ts            = search_latency.go_ts;
+	uint64_t first_node_ts    = search_latency.first_node_ts;
+	uint64_t iteration_end_ts = search_latency.iteration_end_ts;
+	uint64_t stop_ts          = search_latency.stop_ts;
+
+	if (first_node_ts >= go_ts)
+		latency_add(LATENCY_SEARCH_START, first_node_ts - go_ts);
+	if (iteration_end_ts >= go_ts && stop_ts >= iteration_end_ts)
+		latency_add(LATENCY_LAST_ITERATION, stop_ts - iteration_end_ts);
+	if (stop_ts && bestmove_ts >= stop_ts)
+		latency_add(LATENCY_BESTMOVE, bestmove_ts - stop_ts);
+
+	if (first_node_ts >= go_ts && stop_ts && bestmove_ts >= stop_ts)
+		my_trace("# latency go->first node: %" PRIu64 " us, stop->bestmove: %" PRIu64 " us\n", first_node_ts - go_ts, bestmove_ts - stop_ts);
+}
+
+// spin-then-block: after a search the next one often follows quickly, spinning for a
+// short while avoids the wake-up latency of the condition variable
+constexpr uint64_t pool_spin_us = 1000;
+
+// vote weighted by depth and by how much better the score is than the worst thread
+// (as in Stockfish); only called with work.search_fen_lock held
+void select_best_thread()
+{
+	std::vector<search_pars_t *> candidates;
+	for(auto & t: sp) {
+		if (t->result_version == work.search_version && t->result_depth > 0)
+			candidates.push_back(t);
+	}
+
+	if (candidates.size() < 2)
+		return;
+
+	int min_score = 32767;
+	for(auto & t: candidates)
+		min_score = std::min(min_score, t->result_score);
+
+	std::map<uint32_t, int64_t> votes;
+	for(auto & t: candidates)
+		votes[t->result_move.value()] += int64_t(t->result_score - min_score + 14) * t->result_depth;
+
+	search_pars_t *best = candidates.at(0);
+	for(auto & t: candidates) {
+		bool shorter_mate = t->result_score >= 9800 && t->result_score > best->result_score;
+		if (votes[t->result_move.value()] > votes[best->result_move.value()] || shorter_mate)
+			best = t;
+	}
+
+	if (best->result_move != work.search_best_move) {
+		my_trace("# thread %d voted best: %s (depth %d, score %d) instead of %s\n", best->thread_nr, best->result_move.to_str().c_str(), best->result_depth, best->result_score, work.search_best_move.to_str().c_str());
+
+		work.search_best_move  = best->result_move;
+		work.search_best_score = best->result_score;
+	}
+}
+
 void searcher(const int i)
 {
 	printf("Thread %d started\n", i);
 
+#if defined(linux) || defined(_WIN32) || defined(__APPLE__)
+	place_thread(i, sp.at(i), sizeof(search_pars_t));
+#endif
+
+	// a thread created between searches must not run the previous one again
 	int last_fen_version = -1;
+	{
+		std::unique_lock<std::mutex> search_lck(work.search_fen_lock);
+		last_fen_version = work.search_version;
+	}
 
 	for(;;) {
+		uint64_t spin_start = esp_timer_get_time();
+		while(work.search_version == last_fen_version && work.reconfigure_threads == false && esp_timer_get_time() - spin_start < pool_spin_us)
+			std::this_thread::yield();
+
 		std::unique_lock<std::mutex> search_lck(work.search_fen_lock);
+		work.n_sleeping++;
 		while(work.search_version == last_fen_version && work.reconfigure_threads == false)
 			work.search_cv.wait(search_lck);
+		work.n_sleeping--;
 
 		if (work.reconfigure_threads)
 			break;
@@ -276,9 +419,6 @@ void searcher(const int i)
 		auto local_search_max_n_nodes = work.search_max_n_nodes;
 		bool local_search_output      = work.search_output;
 
-		work.search_count_running++;
-
-		clear_flag(sp.at(i)->stop);
 		search_lck.unlock();
 
 		// search!
@@ -289,6 +429,8 @@ void searcher(const int i)
 		// notify finished
 		search_lck.lock();
 
+		sp.at(i)->result_version = last_fen_version;
+
 		if (i == 0) {
 			work.search_best_move  = best_move;
 			work.search_best_score = best_score;
@@ -296,9 +438,17 @@ void searcher(const int i)
 			// stop other threads
 			for(auto & thread_pars : sp)
 				set_flag(thread_pars->stop);
+			root_split_wakeup();
 		}
 
-		work.search_count_running--;
+		work.search_count_pending--;
+
+		// counted against all threads: a helper that did not wake up yet must not
+		// start searching after bestmove was sent
+		if (work.search_count_pending == 0 && work.search_best_move.value() && last_fen_version == work.search_version) {
+			select_best_thread();
+			work.search_finished = true;
+		}
 		work.search_cv_finished.notify_one();
 	}
 
@@ -320,22 +470,70 @@ void prepare_threads_state()
 	}
 }
 
+// the threads must be idle and prepare_threads_state() must have been invoked
+void start_search(const int think_time, const bool is_abs_time, const int max_depth, const std::optional<uint64_t> max_n_nodes, const bool output)
+{
+	std::unique_lock<std::mutex> lck(work.search_fen_lock);
+
+	work.search_think_time    = think_time;
+	work.search_is_abs_time   = is_abs_time;
+	work.search_max_depth     = max_depth;
+	work.search_max_n_nodes   = max_n_nodes;
+	work.search_best_move     = libchess::Move(0);
+	work.search_best_score    = -32768;
+	work.search_output        = output;
+	work.search_finished      = false;
+	work.search_count_pending = sp.size();
+
+	search_latency.first_node_ts    = 0;
+	search_latency.iteration_end_ts = 0;
+	search_latency.stop_ts          = 0;
+	search_latency.go_ts            = esp_timer_get_time();
+
+	// root splitting hands out moves on request, it cannot take turns
+	lockstep_start(deterministic && smp_mode != SMP_ROOTSPLIT ? sp.size() : 1);
+
+	work.search_version++;
+
+	if (work.n_sleeping)
+		work.search_cv.notify_all();
+}
+
+std::pair<libchess::Move, int> wait_search_finished()
+{
+	std::unique_lock<std::mutex> lck(work.search_fen_lock);
+
+	while(work.search_finished == false)
+		work.search_cv_finished.wait(lck);
+
+	return { work.search_best_move, work.search_best_score };
+}
+
+// FNV-1a over the outcome of a search: equal for two runs that behaved identically
+uint64_t search_signature(uint64_t signature, const libchess::Move best_move, const int best_score)
+{
+	uint64_t values[] { best_move.value(), uint64_t(best_score), simple_search_statistics().first };
+
+	for(auto value: values) {
+		for(int i=0; i<8; i++) {
+			signature ^= (value >> (i * 8)) & 255;
+			signature *= 0x100000001b3ull;
+		}
+	}
+
+	return signature;
+}
+
 void start_ponder()
 {
 	my_trace("# start ponder\n");
-	std::unique_lock<std::mutex> lck(work.search_fen_lock);
+
+	reset_ponderhit();
 
 	prepare_threads_state();
 
-	work.search_think_time  = -1;
-	work.search_is_abs_time = false;
-	work.search_max_depth   = -1;
-	work.search_max_n_nodes.reset();
-	work.search_version++;
-	work.search_best_move  = libchess::Move(0);
-	work.search_best_score = -32768;
-	work.search_output     = false;
-	work.search_cv.notify_all();
+	start_search(-1, false, -1, { }, false);
+
 	my_trace("# ponder started\n");
 }
 
@@ -348,13 +546,16 @@ void stop_ponder()
 
 		for(auto & i: sp)
 			set_flag(i->stop);
+		root_split_wakeup();
 
 		work.search_cv.notify_all();
 
-		while(work.search_count_running != 0)
+		while(work.search_count_pending != 0)
 			work.search_cv_finished.wait(lck);
 	}
 
+	reset_ponderhit();
+
 	my_trace("# ponder stopped\n");
 	auto stats = calculate_search_statistics();
 	if (stats.data.nodes || stats.data.qnodes)
@@ -369,6 +570,7 @@ void delete_threads()
 
 		for(auto & i: sp)
 			set_flag(i->stop);
+		root_split_wakeup();
 
 		work.search_cv.notify_all();
 	}
@@ -377,7 +579,6 @@ void delete_threads()
 		i->thread_handle->join();
 		delete i->thread_handle;
 		delete i->stop;
-		free(i->history);
 		delete i;
 	}
 
@@ -392,7 +593,7 @@ void allocate_threads(const int n)
 	delete_threads();
 
 	for(int i=0; i<n; i++) {
-		sp.push_back(new search_pars_t({ reinterpret_cast<int16_t *>(malloc(history_malloc_size)), new end_t, i }));
+		sp.push_back(new search_pars_t { new end_t, i });
 		sp.at(i)->thread_handle = new std::thread(searcher, i);
 	}
 #if defined(ESP32)
@@ -416,12 +617,78 @@ auto hash_size_handler = [](const int value)  {
 	tti.set_size(uint64_t(value) * 1024 * 1024);
 };
 
+#if defined(linux) || defined(_WIN32) || defined(__APPLE__)
+// the table of the df-pn solver ("go mate"), kept between searches like the TT
+int   mate_hash_mb = 16;
+dfpn *mate_solver  = nullptr;
+
+auto mate_hash_handler = [](const int value)  {
+	mate_hash_mb = value;
+	delete mate_solver;  // allocated again by the next "go mate"
+	mate_solver  = nullptr;
+};
+#endif
+
+auto move_overhead_handler = [](const int value)  {
+	move_overhead = value;
+};
+
 bool allow_ponder         = false;
 auto allow_ponder_handler = [](const bool value) {
 	allow_ponder = value;
 	printf("# Ponder %s\n", value ? "enabled" : "disabled");
 };
 
+auto futility_pruning_handler = [](const bool value) {
+	pruning_parameters.futility_enabled = value;
+	printf("# Futility pruning %s\n", value ? "enabled" : "disabled");
+};
+
+auto late_move_pruning_handler = [](const bool value) {
+	pruning_parameters.lmp_enabled = value;
+	printf("# Late move pruning %s\n", value ? "enabled" : "disabled");
+};
+
+auto history_pruning_handler = [](const bool value) {
+	pruning_parameters.history_pruning_enabled = value;
+	printf("# History pruning %s\n", value ? "enabled" : "disabled");
+};
+
+auto smp_mode_handler = [](const std::string & value) {
+	auto mode = smp_mode_from_string(value);
+	if (mode.has_value()) {
+		smp_mode = mode.value();
+		printf("# SMP mode: %s\n", smp_mode_name(smp_mode));
+	}
+	else {
+		printf("# SMP mode %s not known (lazy, abdada or rootsplit)\n", value.c_str());
+	}
+};
+
+auto deterministic_handler = [](const bool value) {
+	deterministic = value;
+	printf("# Deterministic search %s\n", value ? "enabled" : "disabled");
+};
+
+#if defined(linux) || defined(_WIN32) || defined(__APPLE__)
+// the threads are restarted so that they get placed again
+auto affinity_handler = [](const std::string & value) {
+	auto mode = affinity_mode_from_string(value);
+	if (mode.has_value()) {
+		affinity_mode = mode.value();
+		allocate_threads(sp.size());
+	}
+	else {
+		printf("# Affinity %s not known (none, compact or scatter)\n", value.c_str());
+	}
+};
+
+auto numa_bind_handler = [](const bool value) {
+	numa_bind = value;
+	allocate_threads(sp.size());
+};
+#endif
+
 auto commerial_option_handler = [](const std::string & value) { };
 
 auto opponent_option_handler = [](const std::string & value) {
@@ -514,8 +781,27 @@ void gpio_set_level(int a, int b)
 
 void reset_search_statistics()
 {
-        for(auto & i: sp)
+        for(auto & i: sp) {
                 i->cs.reset();
+		i->published_nodes  = 0;
+		i->published_tbhits = 0;
+	}
+}
+
+// called by each search thread every 1024 nodes and when it finishes; other threads
+// only read these (and not the counters in cs that are changed for every node)
+void publish_statistics(search_pars_t & sp)
+{
+	sp.published_nodes.store (sp.cs.data.nodes + sp.cs.data.qnodes, std::memory_order_relaxed);
+	sp.published_tbhits.store(sp.cs.data.syzygy_query_hits,         std::memory_order_relaxed);
+
+#if defined(linux)
+	// board snapshot for the USB display
+	if (sp.thread_nr == 0) {
+		wboard.store(sp.pos.color_bb(libchess::constants::WHITE), std::memory_order_relaxed);
+		bboard.store(sp.pos.color_bb(libchess::constants::BLACK), std::memory_order_relaxed);
+	}
+#endif
 }
 
 chess_stats calculate_search_statistics()
@@ -533,13 +819,62 @@ std::pair<uint64_t, uint64_t> simple_search_statistics()
 	uint64_t syzygy_query_hits = 0, nodes_visited = 0;
 
         for(auto & i: sp) {
-		syzygy_query_hits += i->cs.data.syzygy_query_hits;
-		nodes_visited += i->cs.data.nodes + i->cs.data.qnodes;
+		syzygy_query_hits += i->published_tbhits.load(std::memory_order_relaxed);
+		nodes_visited     += i->published_nodes .load(std::memory_order_relaxed);
 	}
 
 	return { nodes_visited, syzygy_query_hits };
 }
 
+#if defined(linux) || defined(_WIN32) || defined(__APPLE__)
+// "go mate x": use the proof-number solver instead of alpha/beta
+std::optional<std::pair<libchess::Move, int> > find_mate(const int mate_moves, const int think_time)
+{
+	uint64_t start_ts = esp_timer_get_time();
+
+	clear_flag(sp.at(0)->stop);
+
+	std::thread *timer_thread { nullptr };
+	if (think_time > 0)
+		timer_thread = new std::thread([think_time] { timer(think_time, sp.at(0)->stop); });
+
+	// the stop flag changes when the threads are allocated again
+	if (mate_solver && mate_solver->get_stop() != sp.at(0)->stop) {
+		delete mate_solver;
+		mate_solver = nullptr;
+	}
+	if (!mate_solver)
+		mate_solver = new dfpn(sp.at(0)->stop, uint64_t(mate_hash_mb) * 1024 * 1024);
+
+	uint64_t nodes_start = mate_solver->get_node_count();
+	auto     rc          = mate_solver->solve(sp.at(0)->pos, mate_moves == 0 ? dfpn_max_mate_moves : mate_moves);
+
+	if (timer_thread) {
+		set_flag(sp.at(0)->stop);
+		timer_thread->join();
+		delete timer_thread;
+	}
+
+	uint64_t nodes = mate_solver->get_node_count() - nodes_start;
+	uint64_t took  = std::max(uint64_t(1), (esp_timer_get_time() - start_ts) / 1000);
+
+	if (rc.has_value()) {
+		std::string pv_str;
+		for(auto & move : mate_solver->get_pv(sp.at(0)->pos, rc.value().second))
+			pv_str += " " + move.to_str();
+
+		printf("info depth %d score mate %d nodes %" PRIu64 " time %" PRIu64 " nps %" PRIu64 " pv%s\n",
+				rc.value().second * 2 - 1, rc.value().second,
+				nodes, took, nodes * 1000 / took, pv_str.c_str());
+	}
+	else {
+		my_trace("info string no mate found, %" PRIu64 " nodes in %" PRIu64 " ms\n", nodes, took);
+	}
+
+	return rc;
+}
+#endif
+
 void main_task()
 {
 	libchess::UCIService *uci_service = new libchess::UCIService("Dog v3.0", "Folkert van Heusden", std::cout, is);
@@ -548,6 +883,7 @@ void main_task()
 	std::cout.setf(std::ios::unitbuf);
 
 	init_lmr();
+	init_material_table();
 
 	chess_stats global_cs;
 
@@ -576,6 +912,8 @@ void main_task()
 	auto status_handler = [](std::istringstream&) {
 		printf("# Ponder %s\n",  allow_ponder  ? "enabled" : "disabled");
 		printf("# Tracing %s\n", trace_enabled ? "enabled" : "disabled");
+		printf("# SMP mode: %s\n", smp_mode_name(smp_mode));
+		printf("# Deterministic search %s\n", deterministic ? "enabled" : "disabled");
 #if defined(ESP32)
 		show_esp32_info();
 #endif
@@ -587,16 +925,113 @@ void main_task()
 		printf("eval         show evaluation score\n");
 		printf("fen          show fen of current position\n");
 		printf("d / display  show current board layout\n");
-		printf("perft        perft, parameter is depth\n");
+		printf("perft        perft, parameters are depth, [threads] and [hash MB] (0: no perft hash)\n");
+		printf("divide       perft per root move, same parameters as perft\n");
+		printf("perftsuite   check the standard perft positions, parameters: max. depth (5), [threads], [hash MB]\n");
+		printf("latency      show latency histograms (\"latency reset\" clears them), to tune \"Move Overhead\"\n");
+		printf("metrics      engine metrics in Prometheus text format; \"metrics file <name> [interval s]\" rewrites a file periodically, \"metrics off\" stops that\n");
+		printf("timesim      replay the time allocation: ms, increment, moves to go (0: sudden death), number of moves\n");
+#if defined(WITH_TREE_RECORDER)
+		printf("treerec      record the search tree: file, [sample bits] (1 in 2^bits positions); \"treerec off\" stops\n");
+		printf("treedump     histograms of a tree recording (cut-off index, pruning, LMR re-searches), parameter: file\n");
+#endif
 		printf("tui          switch to text interface\n");
 		printf("quit         exit to main menu\n");
 	};
 
-	auto perft_handler = [](std::istringstream& line_stream) {
+	// <depth> [threads] [hash MB]
+	auto get_perft_parameters = [](std::istringstream& line_stream, int *const depth) {
+		perft_parameters_t pars { int(sp.size()), 0 };
+
+		line_stream >> *depth >> pars.n_threads >> pars.hash_mb;
+
+		return pars;
+	};
+
+	auto perft_handler = [get_perft_parameters](std::istringstream& line_stream) {
+		int  depth = 1;
+		auto pars  = get_perft_parameters(line_stream, &depth);
+
+		perft(sp.at(0)->pos, depth, pars);
+	};
+
+	auto divide_handler = [get_perft_parameters](std::istringstream& line_stream) {
+		int  depth = 1;
+		auto pars  = get_perft_parameters(line_stream, &depth);
+
+		perft_divide(sp.at(0)->pos, depth, pars);
+	};
+
+	auto perftsuite_handler = [get_perft_parameters](std::istringstream& line_stream) {
+		int  depth = 5;
+		auto pars  = get_perft_parameters(line_stream, &depth);
+
+		perft_suite(depth, pars);
+	};
+
+	auto timesim_handler = [](std::istringstream& line_stream) {
+		int ms          = 60000;
+		int inc         = 0;
+		int moves_to_go = 0;
+		int n_moves     = 60;
+
+		line_stream >> ms >> inc >> moves_to_go >> n_moves;
+
+		simulate_time_control(ms, inc, moves_to_go, n_moves);
+	};
+
+	auto latency_handler = [](std::istringstream& line_stream) {
+		std::string temp;
+		line_stream >> temp;
+
+		if (temp == "reset")
+			latency_reset();
+		else
+			latency_dump();
+	};
+
+#if defined(WITH_TREE_RECORDER)
+	auto treerec_handler = [](std::istringstream& line_stream) {
+		std::string file;
+		int         sample_bits = 0;
+		line_stream >> file >> sample_bits;
+
+		if (file.empty() || file == "off")
+			tree_recorder_stop();
+		else if (tree_recorder_start(file, sample_bits))
+			printf("# recording 1 in %" PRIu64 " positions to %s\n", tree_recorder_sample_mask.load() + 1, file.c_str());
+	};
+
+	auto treedump_handler = [](std::istringstream& line_stream) {
+		std::string file;
+		line_stream >> file;
+
+		tree_dump(file);
+	};
+#endif
+
+	auto metrics_handler = [](std::istringstream& line_stream) {
 		std::string temp;
 		line_stream >> temp;
 
-		perft(sp.at(0)->pos, std::stoi(temp));
+		if (temp == "file") {
+			std::string file;
+			int         interval = 10;
+			line_stream >> file >> interval;
+
+			metrics_dump_start(file, interval);
+		}
+		else if (temp == "off")
+			metrics_dump_stop();
+		else
+			printf("%s", metrics_text().c_str());
+	};
+
+	auto metrics_file_handler = [](const std::string & value) {
+		if (value.empty())
+			metrics_dump_stop();
+		else
+			metrics_dump_start(value, 10);
 	};
 
 	auto ucinewgame_handler = [&global_cs](std::istringstream&) {
@@ -605,6 +1040,10 @@ void main_task()
 			memset(i->history, 0x00, history_malloc_size);
 		global_cs.reset();
 		tti.reset();
+#if defined(linux) || defined(_WIN32) || defined(__APPLE__)
+		if (mate_solver)
+			mate_solver->reset();
+#endif
 		printf("# --- New game ---\n");
 	};
 
@@ -650,33 +1089,16 @@ void main_task()
 				start_blink(led_green_timer);
 #endif
 
-				// put
-				{
-					std::unique_lock<std::mutex> lck(work.search_fen_lock);
-					work.search_think_time  = think_time.has_value() ? think_time.value() : -1;
-					work.search_is_abs_time = true;
-					work.search_max_depth   = max_depth.has_value() ? max_depth.value() : - 1;
-					work.search_max_n_nodes.reset();
-					work.search_version++;
-					work.search_best_move  = libchess::Move(0);
-					work.search_best_score = -32768;
-					work.search_output     = true;
-					work.search_cv.notify_all();
-				}
-				// get
-				{
-					std::unique_lock<std::mutex> lck(work.search_fen_lock);
-					while(work.search_best_move.value() == 0 || work.search_count_running != 0)
-						work.search_cv_finished.wait(lck);
-				}
+				start_search(think_time.has_value() ? think_time.value() : -1, true, max_depth.has_value() ? max_depth.value() : -1, { }, true);
+				auto [ best_move, best_score ] = wait_search_finished();
 #if defined(ESP32)
 				stop_blink(led_green_timer, &led_green);
 #endif
 				cs_sum.add(calculate_search_statistics());
 
-				printf("# %s %s [%d]\n", sp.at(0)->pos.fen().c_str(), work.search_best_move.to_str().c_str(), work.search_best_score);
+				printf("# %s %s [%d]\n", sp.at(0)->pos.fen().c_str(), best_move.to_str().c_str(), best_score);
 
-				sp.at(0)->pos.make_move(work.search_best_move);
+				sp.at(0)->pos.make_move(best_move);
 			}
 
 			printf("\nFinished.\n");
@@ -692,9 +1114,17 @@ void main_task()
 		}
 	};
 
+	auto ponderhit_handler = [](std::istringstream&) {
+		record_input_latency(esp_timer_get_time());
+
+		end_ponder_go(true);
+	};
+
 	auto go_handler = [&global_cs](const libchess::UCIGoParameters & go_parameters) {
 		uint64_t start_ts = esp_timer_get_time();
 
+		record_input_latency(start_ts);
+
 		try {
 			reset_search_statistics();
 
@@ -708,7 +1138,8 @@ void main_task()
 			start_blink(led_green_timer);
 #endif
 
-			int moves_to_go = 40 - sp.at(0)->pos.fullmoves();
+			auto a_moves_to_go = go_parameters.movestogo();
+			int  moves_to_go   = a_moves_to_go.has_value() ? a_moves_to_go.value() : 40 - sp.at(0)->pos.fullmoves();
 
 			auto depth     = go_parameters.depth();
 			auto nodes     = go_parameters.nodes();
@@ -732,25 +1163,37 @@ void main_task()
 			bool is_absolute_time = false;
 			bool is_white         = sp.at(0)->pos.side_to_move() == libchess::constants::WHITE;
 			if (movetime.has_value()) {
-				think_time       = movetime.value();
+				think_time       = allocate_move_time(movetime.value());
 				is_absolute_time = true;
 			}
 			else {
-				int cur_n_moves  = moves_to_go <= 0 ? 40 : moves_to_go;
 				int time_inc     = is_white ? w_inc  : b_inc;
 				int time_inc_opp = is_white ? b_inc  : w_inc;
 				int ms           = is_white ? w_time : b_time;
 				int ms_opponent  = is_white ? b_time : w_time;
 
-				think_time = (ms + (cur_n_moves - 1) * time_inc) / double(cur_n_moves + 7);
-
-				int limit_duration_min = ms / 15;
-				if (think_time > limit_duration_min)
-					think_time = limit_duration_min;
+				think_time = allocate_think_time(ms, time_inc, moves_to_go);
 
 				my_trace("# My time: %d ms, inc: %d ms, opponent time: %d ms, inc: %d ms, full: %d, half: %d, moves_to_go: %d, tt: %d\n", ms, time_inc, ms_opponent, time_inc_opp, sp.at(0)->pos.fullmoves(), sp.at(0)->pos.halfmoves(), moves_to_go, tti.get_per_mille_filled());
 			}
 
+			// the clock only starts running at the ponderhit
+			// a ponderhit may arrive before the search started: it must survive
+			// until the search picks it up
+			bool is_ponder = go_parameters.ponder();
+			{
+				std::unique_lock<std::mutex> lck(ponder_go.lock);
+				reset_ponderhit();
+
+				ponder_go.hit = false;
+
+				if (is_ponder) {
+					ponder_go.active     = true;
+					ponder_go.think_time = depth.has_value() && think_time == 0 ? -1 : think_time;
+					ponder_go.is_abs     = is_absolute_time;
+				}
+			}
+
 			libchess::Move best_move  { 0 };
 			int            best_score { 0 };
 			bool           has_best   { false };
@@ -758,7 +1201,7 @@ void main_task()
 			// probe the Syzygy endgame table base
 #if defined(linux) || defined(_WIN32) || defined(__APPLE__)
 			if (with_syzygy) {
-				sp.at(0)->cs.data.syzygy_queries++;
+				sp.at(0)->cs.count(sp.at(0)->cs.data.syzygy_queries);
 
 				auto probe_result = probe_fathom_root(sp.at(0)->pos);
 				if (probe_result.has_value()) {
@@ -773,42 +1216,80 @@ void main_task()
 			}
 #endif
 
+#if defined(linux) || defined(_WIN32) || defined(__APPLE__)
+			auto mate = go_parameters.mate();
+			if (!has_best && mate.has_value()) {
+				auto rc = find_mate(mate.value(), think_time);
+				if (rc.has_value()) {
+					best_move  = rc.value().first;
+					best_score = 10000 - rc.value().second * 2 + 1;
+					has_best   = true;
+				}
+				else if (sp.at(0)->stop->flag) {  // interrupted: a move is required right away
+					auto te = tti.lookup(sp.at(0)->pos.hash());
+					if (te.has_value() && te.value().m && sp.at(0)->pos.is_legal_move(libchess::Move(te.value().m)))
+						best_move = libchess::Move(te.value().m);
+					else
+						best_move = *sp.at(0)->pos.legal_move_list().begin();
+					has_best = true;
+				}
+			}
+#endif
+
 			// main search
 			if (!has_best) {
-				// put
-				{
-					std::unique_lock<std::mutex> lck(work.search_fen_lock);
-
-					prepare_threads_state();
-
-					work.search_think_time  = depth.has_value() && think_time == 0 ? -1 : think_time;
-					work.search_is_abs_time = is_absolute_time;
-					work.search_max_depth   = depth.has_value() ? depth.value() : -1;
-					work.search_max_n_nodes = nodes;
-					work.search_version++;
-					work.search_best_move  = libchess::Move(0);
-					work.search_best_score = -32768;
-					work.search_output     = true;
-					work.search_cv.notify_all();
-				}
+				prepare_threads_state();
 
-				// get
-				{
-					std::unique_lock<std::mutex> lck(work.search_fen_lock);
+				start_search(is_ponder || (depth.has_value() && think_time == 0) ? -1 : think_time, is_absolute_time, depth.has_value() ? depth.value() : -1, nodes, true);
 
-					while(work.search_best_move.value() == 0 || work.search_count_running != 0)
-						work.search_cv_finished.wait(lck);
+				std::tie(best_move, best_score) = wait_search_finished();
+			}
 
-					best_move  = work.search_best_move;
-					best_score = work.search_best_score;
-				}
+			if (is_ponder) {
+				std::unique_lock<std::mutex> lck(ponder_go.lock);
+				while(ponder_go.active)
+					ponder_go.cv.wait(lck);
 			}
 
-			// emit result
-			libchess::UCIService::bestmove(best_move.to_str());
+			// emit result, with the expected reply to ponder on
+			std::optional<std::string> ponder_move;
+			std::vector<libchess::Move> pv = get_pv_from_tt(sp.at(0)->pos, best_move);
+			if (pv.size() >= 2)
+				ponder_move = pv.at(1).to_str();
+
+			output_bestmove(best_move.to_str(), ponder_move);
+#if !defined(ESP32)
+			trace_log_flush();
+#endif
+
+			uint64_t bestmove_ts = esp_timer_get_time();
+			if (!has_best)
+				trace_search_latency(bestmove_ts);
+
+			if (deterministic && !has_best)
+				printf("info string signature %016" PRIx64 "\n", search_signature(fnv_offset_basis, best_move, best_score));
+
+			uint64_t used_us = bestmove_ts - start_ts;
+			if (!is_ponder && think_time > 0 && used_us > uint64_t(think_time) * 1000)
+				latency_add(LATENCY_OVERRUN, used_us - think_time * 1000ll);
 
 			my_trace("info string had %d ms, used %.3f ms (including overhead)\n", think_time, (esp_timer_get_time() - start_ts) / 1000.);
 
+			// after a ponderhit the clock ran from the ponderhit, with the time given then
+			bool     ponder_stopped  = false;
+			int      metrics_time    = think_time;
+			uint64_t metrics_used_us = used_us;
+			if (is_ponder) {
+				std::unique_lock<std::mutex> lck(ponder_go.lock);
+				ponder_stopped = !ponder_go.hit;
+				if (ponder_go.hit) {
+					metrics_time    = ponder_go.think_time;
+					metrics_used_us = bestmove_ts >= ponder_go.hit_ts ? bestmove_ts - ponder_go.hit_ts : 0;
+				}
+			}
+
+			metrics_search_done(metrics_time, metrics_used_us, used_us, ponder_stopped);
+
 			// no longer thinking
 #if defined(ESP32)
 			stop_blink(led_green_timer, &led_green);
@@ -822,8 +1303,11 @@ void main_task()
 
 			global_cs.add(calculate_search_statistics());
 
+#if defined(ESP32)
+			// no GUI to send "go ponder": think on the opponent's time by ourselves
 			if (allow_ponder)
 				start_ponder();
+#endif
 		}
 		catch(const std::exception& e) {
 #if defined(__ANDROID__)
@@ -844,8 +1328,32 @@ void main_task()
 	uci_service->register_option(hash_size_option);
 	libchess::UCICheckOption allow_ponder_option("Ponder", allow_ponder, allow_ponder_handler);
 	uci_service->register_option(allow_ponder_option);
+#if defined(linux) || defined(_WIN32) || defined(__APPLE__)
+	libchess::UCISpinOption mate_hash_option("MateHash", mate_hash_mb, 1, 1024, mate_hash_handler);
+	uci_service->register_option(mate_hash_option);
+#endif
+	libchess::UCISpinOption move_overhead_option("Move Overhead", move_overhead, 0, 5000, move_overhead_handler);
+	uci_service->register_option(move_overhead_option);
 	libchess::UCICheckOption allow_tracing_option("Trace", trace_enabled, allow_tracing_handler);
 	uci_service->register_option(allow_tracing_option);
+	libchess::UCICheckOption futility_pruning_option("FutilityPruning", pruning_parameters.futility_enabled, futility_pruning_handler);
+	uci_service->register_option(futility_pruning_option);
+	libchess::UCICheckOption late_move_pruning_option("LateMovePruning", pruning_parameters.lmp_enabled, late_move_pruning_handler);
+	uci_service->register_option(late_move_pruning_option);
+	libchess::UCICheckOption history_pruning_option("HistoryPruning", pruning_parameters.history_pruning_enabled, history_pruning_handler);
+	uci_service->register_option(history_pruning_option);
+	libchess::UCIStringOption smp_mode_option("SMPMode", smp_mode_name(smp_mode), smp_mode_handler);
+	uci_service->register_option(smp_mode_option);
+	libchess::UCICheckOption deterministic_option("Deterministic", deterministic, deterministic_handler);
+	uci_service->register_option(deterministic_option);
+	libchess::UCIStringOption metrics_file_option("MetricsFile", "", metrics_file_handler);
+	uci_service->register_option(metrics_file_option);
+#if defined(linux) || defined(_WIN32) || defined(__APPLE__)
+	libchess::UCIStringOption affinity_option("Affinity", affinity_mode_name(affinity_mode), affinity_handler);
+	uci_service->register_option(affinity_option);
+	libchess::UCICheckOption numa_bind_option("NUMABind", numa_bind, numa_bind_handler);
+	uci_service->register_option(numa_bind_option);
+#endif
 	libchess::UCIStringOption commerial_option("UCI_EngineAbout", "https://vanheusden.com/chess/Dog/", commerial_option_handler);
 	uci_service->register_option(commerial_option);
 	libchess::UCIStringOption opponent_option("UCI_Opponent", "", opponent_option_handler);
@@ -863,9 +1371,19 @@ void main_task()
 	uci_service->register_handler("dog",        dog_handler, false);
 	uci_service->register_handler("max",        dog_handler, false);
 	uci_service->register_handler("perft",      perft_handler, true);
+	uci_service->register_handler("divide",     divide_handler, true);
+	uci_service->register_handler("perftsuite", perftsuite_handler, true);
+	uci_service->register_handler("timesim",    timesim_handler, false);
+	uci_service->register_handler("latency",    latency_handler, false);
+	uci_service->register_handler("metrics",    metrics_handler, false);
+#if defined(WITH_TREE_RECORDER)
+	uci_service->register_handler("treerec",    treerec_handler, true);
+	uci_service->register_handler("treedump",   treedump_handler, true);
+#endif
 	uci_service->register_handler("ucinewgame", ucinewgame_handler, true);
 	uci_service->register_handler("tui",        tui_handler, true);
 	uci_service->register_handler("status",     status_handler, false);
+	uci_service->register_handler("ponderhit",  ponderhit_handler, false);
 	uci_service->register_handler("help",       help_handler, false);
 
 	for(;;) {
@@ -873,7 +1391,8 @@ void main_task()
 		my_printf("# \"test\" will run the unit tests, \"quit\" terminate the application\n");
 
 		std::string line;
-		std::getline(is, line);
+		if (!std::getline(is, line))  // stdin closed or SIGTERM
+			break;
 
 		if (line == "uci") {
 			uci_service->run();
@@ -891,8 +1410,13 @@ void main_task()
 		}
 	}
 
+	metrics_dump_stop();
+
 	delete_threads();
 
+	// after the search threads: a running one would start a new writer
+	output_stop();
+
 	delete uci_service;
 
 	printf("TASK TERMINATED\n");
@@ -912,145 +1436,6 @@ void hello() {
 #endif
 }
 
-void run_bench()
-{
-	init_lmr();
-
-	allocate_threads(1);
-
-        // these fens are taken from https://github.com/lynx-chess/Lynx/blob/main/src/Lynx/Bench.cs
-        const std::vector<std::string> fens {
-                "r3k2r/2pb1ppp/2pp1q2/p7/1nP1B3/1P2P3/P2N1PPP/R2QK2R w KQkq a6 0 14",
-                "4rrk1/2p1b1p1/p1p3q1/4p3/2P2n1p/1P1NR2P/PB3PP1/3R1QK1 b - - 2 24",
-                "r3qbrk/6p1/2b2pPp/p3pP1Q/PpPpP2P/3P1B2/2PB3K/R5R1 w - - 16 42",
-                "6k1/1R3p2/6p1/2Bp3p/3P2q1/P7/1P2rQ1K/5R2 b - - 4 44",
-                "8/8/1p2k1p1/3p3p/1p1P1P1P/1P2PK2/8/8 w - - 3 54",
-                "7r/2p3k1/1p1p1qp1/1P1Bp3/p1P2r1P/P7/4R3/Q4RK1 w - - 0 36",
-                "r1bq1rk1/pp2b1pp/n1pp1n2/3P1p2/2P1p3/2N1P2N/PP2BPPP/R1BQ1RK1 b - - 2 10",
-                "3r3k/2r4p/1p1b3q/p4P2/P2Pp3/1B2P3/3BQ1RP/6K1 w - - 3 87",
-                "2r4r/1p4k1/1Pnp4/3Qb1pq/8/4BpPp/5P2/2RR1BK1 w - - 0 42",
-                "4q1bk/6b1/7p/p1p4p/PNPpP2P/KN4P1/3Q4/4R3 b - - 0 37",
-                "2q3r1/1r2pk2/pp3pp1/2pP3p/P1Pb1BbP/1P4Q1/R3NPP1/4R1K1 w - - 2 34",
-                "1r2r2k/1b4q1/pp5p/2pPp1p1/P3Pn2/1P1B1Q1P/2R3P1/4BR1K b - - 1 37",
-                "r3kbbr/pp1n1p1P/3ppnp1/q5N1/1P1pP3/P1N1B3/2P1QP2/R3KB1R b KQkq b3 0 17",
-                "8/6pk/2b1Rp2/3r4/1R1B2PP/P5K1/8/2r5 b - - 16 42",
-                "1r4k1/4ppb1/2n1b1qp/pB4p1/1n1BP1P1/7P/2PNQPK1/3RN3 w - - 8 29",
-                "8/p2B4/PkP5/4p1pK/4Pb1p/5P2/8/8 w - - 29 68",
-                "3r4/ppq1ppkp/4bnp1/2pN4/2P1P3/1P4P1/PQ3PBP/R4K2 b - - 2 20",
-                "5rr1/4n2k/4q2P/P1P2n2/3B1p2/4pP2/2N1P3/1RR1K2Q w - - 1 49",
-                "1r5k/2pq2p1/3p3p/p1pP4/4QP2/PP1R3P/6PK/8 w - - 1 51",
-                "q5k1/5ppp/1r3bn1/1B6/P1N2P2/BQ2P1P1/5K1P/8 b - - 2 34",
-                "r1b2k1r/5n2/p4q2/1ppn1Pp1/3pp1p1/NP2P3/P1PPBK2/1RQN2R1 w - - 0 22",
-                "r1bqk2r/pppp1ppp/5n2/4b3/4P3/P1N5/1PP2PPP/R1BQKB1R w KQkq - 0 5",
-                "r1bqr1k1/pp1p1ppp/2p5/8/3N1Q2/P2BB3/1PP2PPP/R3K2n b Q - 1 12",
-                "r1bq2k1/p4r1p/1pp2pp1/3p4/1P1B3Q/P2B1N2/2P3PP/4R1K1 b - - 2 19",
-                "r4qk1/6r1/1p4p1/2ppBbN1/1p5Q/P7/2P3PP/5RK1 w - - 2 25",
-                "r7/6k1/1p6/2pp1p2/7Q/8/p1P2K1P/8 w - - 0 32",
-                "r3k2r/ppp1pp1p/2nqb1pn/3p4/4P3/2PP4/PP1NBPPP/R2QK1NR w KQkq - 1 5",
-                "3r1rk1/1pp1pn1p/p1n1q1p1/3p4/Q3P3/2P5/PP1NBPPP/4RRK1 w - - 0 12",
-                "5rk1/1pp1pn1p/p3Brp1/8/1n6/5N2/PP3PPP/2R2RK1 w - - 2 20",
-                "8/1p2pk1p/p1p1r1p1/3n4/8/5R2/PP3PPP/4R1K1 b - - 3 27",
-                "8/4pk2/1p1r2p1/p1p4p/Pn5P/3R4/1P3PP1/4RK2 w - - 1 33",
-                "8/5k2/1pnrp1p1/p1p4p/P6P/4R1PK/1P3P2/4R3 b - - 1 38",
-                "8/8/1p1kp1p1/p1pr1n1p/P6P/1R4P1/1P3PK1/1R6 b - - 15 45",
-                "8/8/1p1k2p1/p1prp2p/P2n3P/6P1/1P1R1PK1/4R3 b - - 5 49",
-                "8/8/1p4p1/p1p2k1p/P2npP1P/4K1P1/1P6/3R4 w - - 6 54",
-                "8/8/1p4p1/p1p2k1p/P2n1P1P/4K1P1/1P6/6R1 b - - 6 59",
-                "8/5k2/1p4p1/p1pK3p/P2n1P1P/6P1/1P6/4R3 b - - 14 63",
-                "8/1R6/1p1K1kp1/p6p/P1p2P1P/6P1/1Pn5/8 w - - 0 67",
-                "1rb1rn1k/p3q1bp/2p3p1/2p1p3/2P1P2N/PP1RQNP1/1B3P2/4R1K1 b - - 4 23",
-                "4rrk1/pp1n1pp1/q5p1/P1pP4/2n3P1/7P/1P3PB1/R1BQ1RK1 w - - 3 22",
-                "r2qr1k1/pb1nbppp/1pn1p3/2ppP3/3P4/2PB1NN1/PP3PPP/R1BQR1K1 w - - 4 12",
-                "2r2k2/8/4P1R1/1p6/8/P4K1N/7b/2B5 b - - 0 55",
-                "6k1/5pp1/8/2bKP2P/2P5/p4PNb/B7/8 b - - 1 44",
-                "2rqr1k1/1p3p1p/p2p2p1/P1nPb3/2B1P3/5P2/1PQ2NPP/R1R4K w - - 3 25",
-                "r1b2rk1/p1q1ppbp/6p1/2Q5/8/4BP2/PPP3PP/2KR1B1R b - - 2 14",
-                "6r1/5k2/p1b1r2p/1pB1p1p1/1Pp3PP/2P1R1K1/2P2P2/3R4 w - - 1 36",
-                "rnbqkb1r/pppppppp/5n2/8/2PP4/8/PP2PPPP/RNBQKBNR b KQkq c3 0 2",
-                "2rr2k1/1p4bp/p1q1p1p1/4Pp1n/2PB4/1PN3P1/P3Q2P/2RR2K1 w - f6 0 20",
-                "3br1k1/p1pn3p/1p3n2/5pNq/2P1p3/1PN3PP/P2Q1PB1/4R1K1 w - - 0 23",
-                "2r2b2/5p2/5k2/p1r1pP2/P2pB3/1P3P2/K1P3R1/7R w - - 23 93",
-                "5k2/4q1p1/3P1pQb/1p1B4/pP5p/P1PR4/5PP1/1K6 b - - 0 38",
-                "6k1/6p1/8/6KQ/1r6/q2b4/8/8 w - - 0 32",
-                "5rk1/1rP3pp/p4n2/3Pp3/1P2Pq2/2Q4P/P5P1/R3R1K1 b - - 0 32",
-                "4r1k1/4r1p1/8/p2R1P1K/5P1P/1QP3q1/1P6/3R4 b - - 0 1",
-                "R4r2/4q1k1/2p1bb1p/2n2B1Q/1N2pP2/1r2P3/1P5P/2B2KNR w - - 3 31",
-                "r6k/pbR5/1p2qn1p/P2pPr2/4n2Q/1P2RN1P/5PBK/8 w - - 2 31",
-                "rn2k3/4r1b1/pp1p1n2/1P1q1p1p/3P4/P3P1RP/1BQN1PR1/1K6 w - - 6 28",
-                "3q1k2/3P1rb1/p6r/1p2Rp2/1P5p/P1N2pP1/5B1P/3QRK2 w - - 1 42",
-                "4r2k/1p3rbp/2p1N1p1/p3n3/P2NB1nq/1P6/4R1P1/B1Q2RK1 b - - 4 32",
-                "4r1k1/1q1r3p/2bPNb2/1p1R3Q/pB3p2/n5P1/6B1/4R1K1 w - - 2 36",
-                "3qr2k/1p3rbp/2p3p1/p7/P2pBNn1/1P3n2/6P1/B1Q1RR1K b - - 1 30",
-                "3qk1b1/1p4r1/1n4r1/2P1b2B/p3N2p/P2Q3P/8/1R3R1K w - - 2 39",
-
-                "6RR/4bP2/8/8/5r2/3K4/5p2/4k3 w - - 0 1",                       // SEE test suite - regular promotion
-                "1n2kb1r/p1P4p/2qb4/5pP1/4n2Q/8/PP1PPP1P/RNB1KBNR w KQk - 0 1", // SEE test suite - promotion with capture
-                "6Q1/8/1kp4P/2q1p3/2PpP3/2nP2P1/p7/5BK1 b - - 1 35",            // Fischer vs Petrosian - double promotion
-                "5R2/2k3PK/8/5N2/7P/5q2/8/q7 w - - 0 69",                       // McShane - Aronian 2012 - knight promotion
-                "rnbqk1nr/ppp2ppp/8/4P3/1BP5/8/PP2KpPP/RN1Q1BNR b kq - 1 7",    // Albin Countergambit, Lasker Trap - knight promotion
-
-                "8/nRp5/8/8/8/7k/8/7K w - - 0 1",                               // R vs NP
-                "8/bRp5/8/8/8/7k/8/7K w - - 0 1",                               // R vs BP
-                "8/8/4k3/3n1n2/5P2/8/3K4/8 b - - 0 12",                         // NN vs P endgame
-                "8/bQr5/8/8/8/7k/8/7K w - - 0 1",                               // Q vs RB, leading to Q vs R or Q vs B
-                "8/nQr5/8/8/8/7k/8/7K w - - 0 1",                               // Q vs RN, leading to Q vs R or Q vs N
-                "4kq2/8/n7/8/8/3Q3b/8/3K4 w - - 0 1",                           // Q vs QBN, leading to Q vs QB or Q vs QN
-                "8/5R2/1n2RK2/8/8/7k/4r3/8 b - - 0 1",                          // RR vs RN endgame, where if black takes, they actually loses
-                "8/n3p3/8/2B5/2b5/7k/P7/7K w - - 0 1",                          // BP vs BNP endgame, leading to B vs BN
-                "8/n3p3/8/2B5/1n6/7k/P7/7K w - - 0 1",                          // BP vs NNP endgame, leading to B vs NN
-                "8/bRn5/8/7b/8/7k/8/7K w - - 0 1",                              // R vs BBN, leading to R vs BN or R vs BB
-                "1b6/1R1r4/8/1n6/7k/8/8/7K w - - 0 1",                          // R vs RBN, leading to R vs BN or R vs RB or R vs RN
-                "8/q5rk/8/8/8/8/Q5RK/7N w - - 0 1",                             // Endgame that can lead to QN vs Q or RN vs R positions
-                "1kr5/2bp3q/Q7/1K6/6q1/6B1/8/8 w - - 0 1",                      // Endgame where triple repetition can and needs to be forced by white
-                "1kr5/2bp3q/R7/1K6/6q1/6B1/8/8 w - - 96 200",                    // Endgame where 50 moves draw can and needs to be forced by white
-                "rnbqk2r/pppp1ppp/5n2/8/Bb2N3/8/PPPPQPPP/RNB1K2R w KQkq - 2 1", // Petroff defense alike position with double check Q and N
-                "rnb1kb1r/pppp1ppp/5n2/8/4N3/8/PPPP1PPP/RNB1R1K1 w kq - 2 5",   // Double check R and N
-                "rnbqk2r/ppp2ppp/3p4/8/1b2Bn2/8/PPPPQPPP/RNB1K2R w KQkq - 2 5", // Double check Q and B
-                "rnbqk2r/ppp2ppp/3p4/8/1b2B3/3n4/PPPP1PPP/RNBQR1K1 w kq - 2 5", // Double check R and B
-                "r3k2r/ppp2ppp/n7/1N1p4/Bb6/8/PPPP1PPP/RNBQ1RK1 w kq - 2 1",    // Double check B and N, castling rights
-                "r3k2r/ppp2ppp/n7/1N1p4/Bb6/8/PPPP1PPP/RNBQ1RK1 w - - 2 1",     // Double check B and N, no castling rights
-        };
-
-	uint64_t start_ts = esp_timer_get_time();
-
-	for(auto & fen: fens) {
-		printf("\33[2K\r%s\r", fen.c_str());
-		fflush(stdout);
-		// put
-		{
-			std::unique_lock<std::mutex> lck(work.search_fen_lock);
-			sp.at(0)->pos = libchess::Position(fen);
-			memset(sp.at(0)->history, 0x00, history_malloc_size);
-			work.search_think_time  = 1 << 31;
-			work.search_is_abs_time = true;
-			work.search_max_depth   = 10;
-			work.search_max_n_nodes.reset();
-			work.search_version++;
-			work.search_best_move  = libchess::Move(0);
-			work.search_best_score = -32768;
-			work.search_output     = false;
-			work.search_cv.notify_all();
-		}
-		// get
-		{
-			std::unique_lock<std::mutex> lck(work.search_fen_lock);
-			while(work.search_best_move.value() == 0 || work.search_count_running != 0)
-				work.search_cv_finished.wait(lck);
-		}
-	}
-	uint64_t end_ts   = esp_timer_get_time();
-
-	uint64_t node_count = sp.at(0)->cs.data.nodes + sp.at(0)->cs.data.qnodes;
-	uint64_t t_diff     = end_ts - start_ts;
-
-	printf("===========================\n");
-	printf("Total time (ms) : %" PRIu64 "\n", t_diff / 1000);
-	printf("Nodes searched  : %" PRIu64 "\n", node_count);
-	printf("Nodes/second    : %" PRIu64 "\n", node_count * 1000000 / t_diff);
-
-	delete_threads();
-}
-
 #if defined(linux) || defined(_WIN32) || defined(__ANDROID__) || defined(__APPLE__)
 void help()
 {
@@ -1063,22 +1448,47 @@ void help()
 	printf("-u x  USB display device\n");
 	printf("-R x  my_trace to file\n");
 	printf("-r    enable tracing to screen\n");
+	printf("-M x  SMP mode: \"lazy\" (default), \"abdada\" or \"rootsplit\"\n");
+	printf("-A x  pin threads to cpus: \"compact\" or \"scatter\"\n");
+	printf("-N    move the memory of each thread to its NUMA node\n");
+	printf("-D    deterministic search (threads take turns; only for depth or node limited searches)\n");
 	printf("-U    run unit tests\n");
-	printf("-Q x:y:z run test type x againt file y with search time z (ms), with x is \"matefinder\"\n");
+	printf("-Q x:y:z run test type x againt file y with search time z (ms), with x is \"matefinder\" or \"pnmatefinder\"\n");
+	printf("bench [depth] [threads] [hash] [fenfile] [--json]  run benchmark (default: depth 10, -t threads, built-in positions)\n");
+	printf("bench scaling [depth [modes [threads]]]  NPS and time-to-depth for 1, 2, 4... threads (default up to 32), modes is e.g. \"lazy,abdada\"\n");
+	printf("microbench [rounds] [fenfile]  ns/op of movegen, make/unmake, NNUE, TT, move sorting and draw detection\n");
+	printf("bench compare old.json new.json  flag significant NPS or node count changes between two --json reports\n");
 }
 
 int main(int argc, char *argv[])
 {
 #if !defined(_WIN32)
 	signal(SIGPIPE, SIG_IGN);
+	// ends the UCI loop as if stdin was closed, for a clean shutdown
+	signal(SIGTERM, [](int) { i.wakeup(); });
 #endif
 
-	hello();
+	// "bench --json": stdout only gets the report
+	bool json_output = false;
+	for(int i=1; i<argc; i++)
+		json_output |= strcmp(argv[i], "--json") == 0;
+	if (!json_output)
+		hello();
 
 #if !defined(__ANDROID__)
 	int thread_count =  1;
 	int c            = -1;
-	while((c = getopt(argc, argv, "t:ps:u:UR:rH:Q:h")) != -1) {
+
+	// the arguments of "bench" and "microbench" are not options
+	int n_options    = argc;
+	for(int i=1; i<argc; i++) {
+		if (strcmp(argv[i], "bench") == 0 || strcmp(argv[i], "microbench") == 0) {
+			n_options = i;
+			break;
+		}
+	}
+
+	while((c = getopt(n_options, argv, "t:ps:u:UR:rH:Q:M:A:NDh")) != -1) {
 		if (c == 'U') {
 			run_tests();
 			return 1;
@@ -1088,6 +1498,8 @@ int main(int argc, char *argv[])
 			auto parts = split(optarg, ":");
 			if (parts[0] == "matefinder")
 				test_mate_finder(parts[1], std::stoi(parts[2]));
+			else if (parts[0] == "pnmatefinder")
+				test_pn_mate_finder(parts[1], std::stoi(parts[2]));
 			else {
 				printf("Test type %s not known\n", parts[0].c_str());
 				return 1;
@@ -1114,6 +1526,28 @@ int main(int argc, char *argv[])
                         trace_enabled = true;
 		else if (c == 'H')
 			tti.set_size(uint64_t(atol(optarg)) * 1024 * 1024);
+#if defined(linux) || defined(_WIN32) || defined(__APPLE__)
+		else if (c == 'A') {
+			auto mode = affinity_mode_from_string(optarg);
+			if (mode.has_value() == false) {
+				printf("Affinity %s not known\n", optarg);
+				return 1;
+			}
+			affinity_mode = mode.value();
+		}
+		else if (c == 'N')
+			numa_bind = true;
+#endif
+		else if (c == 'D')
+			deterministic = true;
+		else if (c == 'M') {
+			auto mode = smp_mode_from_string(optarg);
+			if (mode.has_value() == false) {
+				printf("SMP mode %s not known\n", optarg);
+				return 1;
+			}
+			smp_mode = mode.value();
+		}
 		else {
 			help();
 
@@ -1121,14 +1555,87 @@ int main(int argc, char *argv[])
 		}
 	}
 #endif
+	if (optind < argc && strcmp(argv[optind], "microbench") == 0) {
+		int         n_rounds = optind + 1 < argc ? std::max(1, atoi(argv[optind + 1])) : 10;
+		std::string fen_file = optind + 2 < argc ? argv[optind + 2] : "";
+
+		run_microbench(n_rounds, fen_file);
+		return 0;
+	}
+
 	// for openbench
 	if (optind < argc && strcmp(argv[optind], "bench") == 0) {
-		run_bench();
+		std::vector<std::string> args(argv + optind + 1, argv + argc);
+
+		if (args.size() >= 1 && args[0] == "compare") {
+			if (args.size() < 3) {
+				help();
+				return 1;
+			}
+
+			return run_bench_compare(args[1], args[2]);
+		}
+
+		bench_parameters_t pars;
+		pars.n_threads = thread_count;
+
+		if (args.size() >= 1 && args[0] == "scaling") {
+			std::vector<smp_mode_t> modes { smp_mode };
+			if (args.size() >= 3) {
+				modes.clear();
+				for(auto & name: split(args[2], ",")) {
+					auto mode = smp_mode_from_string(name);
+					if (mode.has_value() == false) {
+						printf("SMP mode %s not known\n", name.c_str());
+						return 1;
+					}
+					modes.push_back(mode.value());
+				}
+			}
+
+			pars.depth     = args.size() >= 2 ? atoi(args[1].c_str()) : 10;
+			pars.n_threads = args.size() >= 4 ? atoi(args[3].c_str()) : 32;
+			if (pars.depth < 1 || pars.n_threads < 1) {
+				help();
+				return 1;
+			}
+
+			run_bench_scaling(pars, modes);
+			return 0;
+		}
+
+		// depth, threads, hash (MB), fen file; in that order
+		int n_positional = 0;
+		for(auto & arg: args) {
+			if (arg == "--json")
+				pars.json = true;
+			else if (n_positional == 0)
+				pars.depth     = atoi(arg.c_str()), n_positional++;
+			else if (n_positional == 1)
+				pars.n_threads = atoi(arg.c_str()), n_positional++;
+			else if (n_positional == 2)
+				pars.hash_mb   = atoi(arg.c_str()), n_positional++;
+			else
+				pars.fen_file  = arg;
+		}
+
+		if (pars.depth < 1 || pars.n_threads < 1 || pars.hash_mb < 0) {
+			help();
+			return 1;
+		}
+
+		run_bench(pars);
 		return 0;
 	}
 
-	if (my_trace_file.empty() == false)
+#if !defined(ESP32)
+	if (my_trace_file.empty() == false && trace_log_open(my_trace_file))
 		my_trace("# tracing to file enabled\n");
+#endif
+
+#if defined(linux) || defined(_WIN32) || defined(__APPLE__)
+	report_topology();
+#endif
 
 	allocate_threads(thread_count);
 
@@ -2,25 +2,47 @@
 #include <atomic>
 #include <condition_variable>
 #include <cstdint>
+#include <optional>
 #include <thread>
 #include <libchess/Position.h>
 
+#include "material.h"
 #include "nnue.h"
 #include "stats.h"
 
 
+constexpr int max_search_ply = 256;
+
+constexpr size_t history_size        = 2 * 6 * 64;
+constexpr size_t history_malloc_size = sizeof(int16_t) * history_size;
+
+constexpr int cache_line_size = 64;
+
+constexpr int16_t no_static_eval = -32768;
+
+typedef struct {
+	material_key_t material_key;
+	int16_t        static_eval;
+	libchess::Move excluded_move;  // singular extension verification search
+} stack_entry_t;
+
 typedef struct {
 	std::atomic_bool        flag;
 	std::condition_variable cv;
 	std::mutex              cv_lock;
 } end_t;
 
-typedef struct
+// cache line aligned so that threads do not write into each others lines
+typedef struct alignas(cache_line_size)
 {
-	int16_t   *const history { nullptr };
 	end_t           *stop    { nullptr };
 	const int        thread_nr;
-	chess_stats      cs;
+
+	// node counters as seen by other threads, see publish_statistics()
+	alignas(cache_line_size) std::atomic<uint64_t> published_nodes  { 0 };
+	std::atomic<uint64_t>                          published_tbhits { 0 };
+
+	alignas(cache_line_size) chess_stats cs;
 #if defined(ESP32)
 	uint16_t         md;
 #endif
@@ -33,6 +55,18 @@ typedef struct
 
 	libchess::Move     best_moves[128];
 
+	// last completed iteration, used for selecting the best thread
+	libchess::Move     result_move;
+	int                result_score;
+	int                result_depth;
+	int                result_version { -1 };
+
+	stack_entry_t      stack[max_search_ply];
+	int                ply;
+	uint64_t           root_best_move_nodes;  // nodes that went into the current best root move
+
+	int16_t            history[history_size];
+
 	std::thread       *thread_handle { nullptr };
 } search_pars_t;
 
@@ -42,9 +76,6 @@ extern std::vector<search_pars_t *> sp;
 uint64_t esp_timer_get_time();
 #endif
 
-constexpr size_t history_size        = 2 * 6 * 64;
-constexpr size_t history_malloc_size = sizeof(int16_t) * history_size;
-
 #include "inbuf.h"
 #include "tt.h"
 
@@ -52,8 +83,8 @@ extern bool               trace_enabled;
 extern inbuf              i;
 extern std::istream       is;
 extern tt                 tti;
-extern uint64_t           bboard;
-extern uint64_t           wboard;
+extern std::atomic<uint64_t> bboard;
+extern std::atomic<uint64_t> wboard;
 extern bool               with_syzygy;
 
 #if defined(ESP32)
@@ -87,8 +118,19 @@ void set_flag(end_t *const stop);
 void clear_flag(end_t *const stop);
 void start_ponder();
 void stop_ponder();
+void start_search(const int think_time, const bool is_abs_time, const int max_depth, const std::optional<uint64_t> max_n_nodes, const bool output);
+std::pair<libchess::Move, int> wait_search_finished();
+constexpr uint64_t fnv_offset_basis = 0xcbf29ce484222325ull;
+uint64_t search_signature(uint64_t signature, const libchess::Move best_move, const int best_score);
+
+void record_first_node();
+void record_iteration_end();
+void record_stop_request();
 void set_thread_name(std::string name);
 chess_stats calculate_search_statistics();
+void publish_statistics(search_pars_t & sp);
 std::pair<uint64_t, uint64_t> simple_search_statistics();  // nodes, syzyg hits
 void allocate_threads(const int n);
 void delete_threads();
+void prepare_threads_state();
+void reset_search_statistics();
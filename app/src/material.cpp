@@ -0,0 +1,134 @@
+#include <algorithm>
+#include <cstdlib>
+#include <libchess/Position.h>
+
+#include "material.h"
+
+
+// per side: pawns 0..2+, knights/bishops/rooks 0..2+, queens 0..1+
+constexpr int side_combinations = 3 * 3 * 3 * 3 * 2;
+
+static material_entry material_table[side_combinations * side_combinations];
+
+static inline int count(const material_key_t key, const libchess::Color c, const libchess::PieceType t)
+{
+	return (key >> ((c * 5 + t) * 4)) & 15;
+}
+
+static inline int side_index(const material_key_t key, const libchess::Color c)
+{
+	using namespace libchess::constants;
+
+	int p = std::min(count(key, c, PAWN  ), 2);
+	int n = std::min(count(key, c, KNIGHT), 2);
+	int b = std::min(count(key, c, BISHOP), 2);
+	int r = std::min(count(key, c, ROOK  ), 2);
+	int q = std::min(count(key, c, QUEEN ), 1);
+
+	return (((p * 3 + n) * 3 + b) * 3 + r) * 2 + q;
+}
+
+static inline int table_index(const material_key_t key)
+{
+	return side_index(key, libchess::constants::WHITE) * side_combinations + side_index(key, libchess::constants::BLACK);
+}
+
+material_key_t calculate_material_key(const libchess::Position & pos)
+{
+	material_key_t key = 0;
+
+	for(libchess::Color c : { libchess::constants::WHITE, libchess::constants::BLACK }) {
+		for(libchess::PieceType t : { libchess::constants::PAWN, libchess::constants::KNIGHT, libchess::constants::BISHOP, libchess::constants::ROOK, libchess::constants::QUEEN })
+			key += material_delta(c, t) * std::min(pos.piece_type_bb(t, c).popcount(), 15);
+	}
+
+	return key;
+}
+
+typedef struct {
+	int p, n, b, r, q;
+} side_counts;
+
+static int side_value(const side_counts & s)
+{
+	return s.p * 100 + (s.n + s.b) * 300 + s.r * 500 + s.q * 900;
+}
+
+// same rules as is_insufficient_material_draw(), but on counts only
+static material_entry classify(const side_counts & w, const side_counts & b)
+{
+	material_entry e { MAT_UNKNOWN, false, material_scale_unity };
+
+	bool w_bare = w.p + w.n + w.b + w.r + w.q == 0;
+	bool b_bare = b.p + b.n + b.b + b.r + b.q == 0;
+
+	if (w.p + b.p + w.r + b.r + w.q + b.q == 0) {
+		bool sufficient = (w.n && w.b) || (b.n && b.b) ||
+				w.n >= 2 || b.n >= 2 ||
+				(w.b && b.n) || (b.b && w.n) ||
+				((w.b || w.n) && b.n) || ((b.b || b.n) && w.n);
+
+		if (!sufficient) {
+			e.kind          = MAT_INSUFFICIENT;
+			e.bishop_colors = w.b || b.b;
+			// with bishops it depends on their square colors (e.g. KBBK), see evaluate()
+			e.scale         = e.bishop_colors ? material_scale_unity : 0;
+			return e;
+		}
+	}
+
+	if (w_bare != b_bare) {
+		const side_counts & strong = w_bare ? b : w;
+
+		if (strong.q || strong.r || (strong.b && strong.n)) {
+			e.kind = MAT_KNOWN_WIN;
+			return e;
+		}
+
+		if (strong.p == 0 && strong.n == 2 && strong.b == 0) {  // KNNK
+			e.kind  = MAT_LIKELY_DRAW;
+			e.scale = 1;
+			return e;
+		}
+	}
+
+	// pawnless and less than a rook ahead
+	if (w.p + b.p == 0 && !w_bare && !b_bare && abs(side_value(w) - side_value(b)) < 400) {
+		e.kind  = MAT_LIKELY_DRAW;
+		e.scale = material_scale_unity / 4;
+	}
+
+	return e;
+}
+
+void init_material_table()
+{
+	for(int wi=0; wi<side_combinations; wi++) {
+		side_counts w { wi / 54, wi / 18 % 3, wi / 6 % 3, wi / 2 % 3, wi % 2 };
+
+		for(int bi=0; bi<side_combinations; bi++) {
+			side_counts b { bi / 54, bi / 18 % 3, bi / 6 % 3, bi / 2 % 3, bi % 2 };
+
+			material_table[wi * side_combinations + bi] = classify(w, b);
+		}
+	}
+}
+
+material_entry probe_material(const material_key_t key)
+{
+	return material_table[table_index(key)];
+}
+
+bool is_material_draw(const material_key_t key, const libchess::Position & pos)
+{
+	const material_entry & e = material_table[table_index(key)];
+	if (e.kind != MAT_INSUFFICIENT)
+		return false;
+	if (e.bishop_colors == false)
+		return true;
+
+	constexpr uint64_t white_squares = 0x55aa55aa55aa55aall;
+	constexpr uint64_t black_squares = 0xaa55aa55aa55aa55ll;
+	const libchess::Bitboard piece_bb = pos.piece_type_bb(libchess::constants::BISHOP);
+	return !((piece_bb & black_squares) && (piece_bb & white_squares));
+}
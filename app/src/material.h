@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <libchess/Position.h>
+
+
+// piece counts (kings excluded), 4 bits per color/piece-type
+typedef uint64_t material_key_t;
+
+typedef enum { MAT_UNKNOWN = 0, MAT_INSUFFICIENT = 1, MAT_LIKELY_DRAW = 2, MAT_KNOWN_WIN = 3 } material_class;
+
+typedef struct
+{
+	uint8_t kind          : 2;
+	uint8_t bishop_colors : 1;  // only a draw when all bishops are on the same square color
+	uint8_t scale         : 5;  // evaluation is multiplied by scale / material_scale_unity
+} material_entry;
+
+constexpr int material_scale_unity = 16;
+
+constexpr material_key_t material_delta(const libchess::Color c, const libchess::PieceType t)
+{
+	return material_key_t(1) << ((c * 5 + t) * 4);
+}
+
+material_key_t calculate_material_key(const libchess::Position & pos);
+void           init_material_table();
+material_entry probe_material(const material_key_t key);
+bool           is_material_draw(const material_key_t key, const libchess::Position & pos);
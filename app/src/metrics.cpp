@@ -0,0 +1,207 @@
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "latency.h"
+#include "main.h"
+#include "metrics.h"
+#include "tt.h"
+
+
+static const char *const latency_labels[LATENCY_N] = { "input", "search_start", "last_iteration", "bestmove", "overrun" };
+
+static struct {
+	std::mutex            lock;
+
+	uint64_t              n_timed_searches  { 0  };
+	uint64_t              allocated_ms      { 0  };
+	uint64_t              used_us           { 0  };
+	double                last_usage_ratio  { 0. };
+
+	uint64_t              n_ponder          { 0  };
+	uint64_t              n_ponder_hit      { 0  };
+
+	uint64_t              syzygy_queries    { 0  };
+	uint64_t              syzygy_hits       { 0  };
+
+	std::vector<uint64_t> thread_nodes;  // since the start
+	std::vector<double>   thread_nps;    // of the last search
+} metrics;
+
+static struct {
+	std::mutex              lock;
+	std::condition_variable cv;
+	std::thread            *th   { nullptr };
+	bool                    quit { false   };
+} dumper;
+
+void metrics_search_done(const int think_time, const uint64_t used_us, const uint64_t search_us, const bool ponder_stopped)
+{
+	std::unique_lock<std::mutex> lck(metrics.lock);
+
+	if (!ponder_stopped && think_time > 0) {
+		metrics.n_timed_searches++;
+		metrics.allocated_ms    += think_time;
+		metrics.used_us         += used_us;
+		metrics.last_usage_ratio = used_us / (think_time * 1000.);
+	}
+
+	if (metrics.thread_nodes.size() < sp.size()) {
+		metrics.thread_nodes.resize(sp.size());
+		metrics.thread_nps  .resize(sp.size());
+	}
+
+	for(size_t i=0; i<sp.size(); i++) {
+		uint64_t nodes = sp.at(i)->cs.data.nodes + sp.at(i)->cs.data.qnodes;
+		if (nodes == 0)
+			continue;
+
+		metrics.thread_nodes[i] += nodes;
+		metrics.thread_nps  [i]  = search_us ? nodes * 1000000. / search_us : 0.;
+	}
+
+	chess_stats cs = calculate_search_statistics();
+	metrics.syzygy_queries += cs.data.syzygy_queries;
+	metrics.syzygy_hits    += cs.data.syzygy_query_hits;
+}
+
+void metrics_ponder_end(const bool is_hit)
+{
+	std::unique_lock<std::mutex> lck(metrics.lock);
+
+	metrics.n_ponder++;
+	metrics.n_ponder_hit += is_hit;
+}
+
+static void add(std::string *const out, const char *const fmt, ...)
+{
+	char buffer[256];
+
+	va_list ap;
+	va_start(ap, fmt);
+	vsnprintf(buffer, sizeof buffer, fmt, ap);
+	va_end(ap);
+
+	*out += buffer;
+}
+
+static void add_header(std::string *const out, const char *const name, const char *const type, const char *const help)
+{
+	add(out, "# HELP %s %s\n", name, help);
+	add(out, "# TYPE %s %s\n", name, type);
+}
+
+std::string metrics_text()
+{
+	std::string out;
+
+	std::unique_lock<std::mutex> lck(metrics.lock);
+
+	add_header(&out, "dog_nodes_total", "counter", "Nodes searched, per thread.");
+	for(size_t i=0; i<metrics.thread_nodes.size(); i++)
+		add(&out, "dog_nodes_total{thread=\"%zu\"} %" PRIu64 "\n", i, metrics.thread_nodes[i]);
+
+	add_header(&out, "dog_nps", "gauge", "Nodes per second of the last search, per thread.");
+	for(size_t i=0; i<metrics.thread_nps.size(); i++)
+		add(&out, "dog_nps{thread=\"%zu\"} %.0f\n", i, metrics.thread_nps[i]);
+
+	add_header(&out, "dog_tt_fill_ratio", "gauge", "Part of the transposition table that is in use.");
+	add(&out, "dog_tt_fill_ratio %.3f\n", tti.get_per_mille_filled() / 1000.);
+
+	add_header(&out, "dog_syzygy_queries_total", "counter", "Syzygy table base probes.");
+	add(&out, "dog_syzygy_queries_total %" PRIu64 "\n", metrics.syzygy_queries);
+	add_header(&out, "dog_syzygy_hits_total", "counter", "Syzygy table base probes that gave a result.");
+	add(&out, "dog_syzygy_hits_total %" PRIu64 "\n", metrics.syzygy_hits);
+	add_header(&out, "dog_syzygy_hit_ratio", "gauge", "Syzygy hits per probe.");
+	add(&out, "dog_syzygy_hit_ratio %.4f\n", metrics.syzygy_queries ? metrics.syzygy_hits / double(metrics.syzygy_queries) : 0.);
+
+	add_header(&out, "dog_timed_searches_total", "counter", "Searches with a time limit.");
+	add(&out, "dog_timed_searches_total %" PRIu64 "\n", metrics.n_timed_searches);
+	add_header(&out, "dog_time_allocated_seconds_total", "counter", "Think time given to searches with a time limit.");
+	add(&out, "dog_time_allocated_seconds_total %.3f\n", metrics.allocated_ms / 1000.);
+	add_header(&out, "dog_time_used_seconds_total", "counter", "Time from go to bestmove of searches with a time limit.");
+	add(&out, "dog_time_used_seconds_total %.3f\n", metrics.used_us / 1000000.);
+	add_header(&out, "dog_time_usage_ratio", "gauge", "Used/allocated time of the last search with a time limit.");
+	add(&out, "dog_time_usage_ratio %.4f\n", metrics.last_usage_ratio);
+
+	add_header(&out, "dog_ponder_total", "counter", "Ponder searches that ended.");
+	add(&out, "dog_ponder_total %" PRIu64 "\n", metrics.n_ponder);
+	add_header(&out, "dog_ponder_hits_total", "counter", "Ponder searches that ended with a ponderhit.");
+	add(&out, "dog_ponder_hits_total %" PRIu64 "\n", metrics.n_ponder_hit);
+	add_header(&out, "dog_ponder_hit_ratio", "gauge", "Ponderhits per ponder search.");
+	add(&out, "dog_ponder_hit_ratio %.4f\n", metrics.n_ponder ? metrics.n_ponder_hit / double(metrics.n_ponder) : 0.);
+
+	lck.unlock();
+
+	add_header(&out, "dog_latency_seconds", "summary", "Latencies of the UCI loop, see the latency command.");
+	for(int kind=0; kind<LATENCY_N; kind++) {
+		const char *label = latency_labels[kind];
+
+		for(double q: { 0.5, 0.9, 0.99 })
+			add(&out, "dog_latency_seconds{kind=\"%s\",quantile=\"%g\"} %.6f\n", label, q, latency_percentile(latency_kind_t(kind), q) / 1000000.);
+		add(&out, "dog_latency_seconds_sum{kind=\"%s\"} %.6f\n", label, latency_sum(latency_kind_t(kind)) / 1000000.);
+		add(&out, "dog_latency_seconds_count{kind=\"%s\"} %" PRIu64 "\n", label, latency_count(latency_kind_t(kind)));
+	}
+
+	return out;
+}
+
+// the collector must never see a half written file
+static void write_metrics(const std::string & file)
+{
+	std::string temp = file + ".tmp";
+
+	FILE *fh = fopen(temp.c_str(), "w");
+	if (!fh)
+		return;
+
+	std::string text = metrics_text();
+	bool        ok   = fwrite(text.c_str(), 1, text.size(), fh) == text.size();
+	ok &= fclose(fh) == 0;
+
+	if (ok)
+		rename(temp.c_str(), file.c_str());
+}
+
+void metrics_dump_start(const std::string & file, const int interval_s)
+{
+	metrics_dump_stop();
+
+	std::unique_lock<std::mutex> lck(dumper.lock);
+	dumper.quit = false;
+	dumper.th   = new std::thread([file, interval_s] {
+			std::unique_lock<std::mutex> lck(dumper.lock);
+
+			while(!dumper.quit) {
+				lck.unlock();
+				write_metrics(file);
+				lck.lock();
+
+				dumper.cv.wait_for(lck, std::chrono::seconds(std::max(1, interval_s)), [] { return dumper.quit; });
+			}
+		});
+}
+
+void metrics_dump_stop()
+{
+	std::unique_lock<std::mutex> lck(dumper.lock);
+	if (!dumper.th)
+		return;
+
+	dumper.quit = true;
+	dumper.cv.notify_all();
+	lck.unlock();
+
+	dumper.th->join();
+
+	lck.lock();
+	delete dumper.th;
+	dumper.th = nullptr;
+}
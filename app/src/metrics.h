@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+
+// engine telemetry in the Prometheus text exposition format, see the "metrics" command
+
+// think_time <= 0: no time limit; after a ponderhit think_time and used_us count from the
+// hit, search_us (for the nps) is always from go to bestmove
+void metrics_search_done(const int think_time, const uint64_t used_us, const uint64_t search_us, const bool ponder_stopped);
+void metrics_ponder_end(const bool is_hit);
+
+std::string metrics_text();
+
+// (re)writes "file" every interval_s seconds, for the textfile collector of the node-exporter
+void metrics_dump_start(const std::string & file, const int interval_s);
+void metrics_dump_stop();
@@ -0,0 +1,227 @@
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+#include <libchess/Position.h>
+
+#include "bench.h"
+#include "eval.h"
+#include "main.h"
+#include "material.h"
+#include "nnue.h"
+#include "search.h"
+#include "tt.h"
+
+
+typedef struct {
+	uint64_t n_ops;
+	double   ns;
+} round_result_t;
+
+typedef struct {
+	const char                      *name;
+	std::function<round_result_t()>  round;
+} microbench_t;
+
+// times all of "f", which returns the number of operations done
+static round_result_t timed(const std::function<uint64_t()> & f)
+{
+	auto     start = std::chrono::steady_clock::now();
+	uint64_t n_ops = f();
+	auto     end   = std::chrono::steady_clock::now();
+
+	return { n_ops, std::chrono::duration<double, std::nano>(end - start).count() };
+}
+
+// prevents the compiler from optimizing away the measured calls
+static volatile uint64_t sink = 0;
+
+static Eval build_eval(const libchess::Position & pos)
+{
+	Eval e;
+
+	for(libchess::PieceType type : libchess::constants::PIECE_TYPES) {
+		for(libchess::Color color : { libchess::constants::WHITE, libchess::constants::BLACK }) {
+			libchess::Bitboard piece_bb = pos.piece_type_bb(type, color);
+			while(piece_bb) {
+				libchess::Square sq = piece_bb.forward_bitscan();
+				piece_bb.forward_popbit();
+				e.add_piece(type, sq, color == libchess::constants::WHITE);
+			}
+		}
+	}
+
+	return e;
+}
+
+// the bench positions plus every position one legal move further
+static std::vector<libchess::Position> get_corpus(const std::string & fen_file)
+{
+	std::vector<libchess::Position> out;
+
+	for(auto & fen: load_bench_fens(fen_file)) {
+		libchess::Position pos { fen };
+		out.push_back(pos);
+
+		for(auto & move: pos.legal_move_list()) {
+			pos.make_move(move);
+			out.push_back(pos);
+			pos.unmake_move();
+		}
+	}
+
+	return out;
+}
+
+void run_microbench(const int n_rounds, const std::string & fen_file)
+{
+	init_lmr();
+	init_material_table();
+
+	allocate_threads(1);
+
+	std::vector<libchess::Position> corpus = get_corpus(fen_file);
+
+	std::vector<Eval> evals;
+	for(auto & pos: corpus)
+		evals.push_back(build_eval(pos));
+
+	// the move lists are made once, so that only the primitive itself is timed
+	std::vector<libchess::MoveList> pseudo_legal_lists;
+	std::vector<libchess::MoveList> legal_lists;
+	for(auto & pos: corpus) {
+		pseudo_legal_lists.push_back(pos.pseudo_legal_move_list());
+		legal_lists       .push_back(pos.legal_move_list());
+	}
+
+	printf("%zu positions, %d rounds (after 1 warm-up round)\n", corpus.size(), n_rounds);
+
+	std::vector<microbench_t> benches {
+		{ "pseudo_legal_move_list", [&]() {
+				return timed([&]() {
+					for(auto & pos: corpus)
+						sink += pos.pseudo_legal_move_list().size();
+					return uint64_t(corpus.size());
+				});
+			} },
+		{ "is_legal_generated_move", [&]() {
+				return timed([&]() {
+					uint64_t n = 0;
+					for(size_t i=0; i<corpus.size(); i++) {
+						for(auto & move: pseudo_legal_lists[i])
+							sink += corpus[i].is_legal_generated_move(move);
+						n += pseudo_legal_lists[i].size();
+					}
+					return n;
+				});
+			} },
+		{ "make_move + unmake_move", [&]() {
+				return timed([&]() {
+					uint64_t n = 0;
+					for(size_t i=0; i<corpus.size(); i++) {
+						auto & pos = corpus[i];
+						for(auto & move: legal_lists[i]) {
+							pos.make_move(move);
+							sink += pos.hash();
+							pos.unmake_move();
+						}
+						n += legal_lists[i].size();
+					}
+					return n;
+				});
+			} },
+		{ "nnue_evaluate", [&]() {
+				return timed([&]() {
+					for(auto & pos: corpus)
+						sink += nnue_evaluate(pos);
+					return uint64_t(corpus.size());
+				});
+			} },
+		{ "Eval::evaluate", [&]() {
+				return timed([&]() {
+					for(size_t i=0; i<evals.size(); i++)
+						sink += evals[i].evaluate(corpus[i].side_to_move() == libchess::constants::WHITE);
+					return uint64_t(evals.size());
+				});
+			} },
+		{ "tti.store", [&]() {
+				return timed([&]() {
+					for(auto & pos: corpus)
+						tti.store(pos.hash(), EXACT, 5, 0);
+					return uint64_t(corpus.size());
+				});
+			} },
+		{ "tti.lookup", [&]() {
+				return timed([&]() {
+					for(auto & pos: corpus)
+						sink += tti.lookup(pos.hash()).has_value();
+					return uint64_t(corpus.size());
+				});
+			} },
+		// per sort_movelist() call (of a copy of a prebuilt list); setting up the
+		// position of the search state is not timed
+		{ "sort_movelist", [&]() {
+				constexpr int  n_repeats = 32;
+				round_result_t result { 0, 0. };
+
+				for(size_t i=0; i<corpus.size(); i++) {
+					sp.at(0)->pos = corpus[i];
+					sort_movelist_compare smc(*sp.at(0));
+
+					result = { result.n_ops + n_repeats, result.ns + timed([&]() {
+						for(int r=0; r<n_repeats; r++) {
+							libchess::MoveList move_list = pseudo_legal_lists[i];
+							sort_movelist(move_list, smc);
+							sink += move_list.size();
+						}
+						return uint64_t(n_repeats);
+					}).ns };
+				}
+
+				return result;
+			} },
+		{ "is_insufficient_material_draw", [&]() {
+				return timed([&]() {
+					for(auto & pos: corpus)
+						sink += is_insufficient_material_draw(pos);
+					return uint64_t(corpus.size());
+				});
+			} },
+	};
+
+	printf("%-30s %10s %10s %10s %10s\n", "primitive", "ops/round", "ns/op", "stddev", "min");
+
+	for(auto & b: benches) {
+		b.round();  // warm-up
+
+		std::vector<double> ns_per_op;
+		uint64_t            n_ops = 0;
+
+		for(int r=0; r<n_rounds; r++) {
+			round_result_t result = b.round();
+			n_ops = result.n_ops;
+
+			ns_per_op.push_back(result.ns / std::max(uint64_t(1), n_ops));
+		}
+
+		double mean = 0;
+		for(auto v: ns_per_op)
+			mean += v;
+		mean /= ns_per_op.size();
+
+		double sd = 0;
+		for(auto v: ns_per_op)
+			sd += (v - mean) * (v - mean);
+		sd = ns_per_op.size() > 1 ? sqrt(sd / (ns_per_op.size() - 1)) : 0;
+
+		printf("%-30s %10" PRIu64 " %10.1f %10.1f %10.1f\n", b.name, n_ops, mean, sd, *std::min_element(ns_per_op.begin(), ns_per_op.end()));
+	}
+
+	tti.reset();
+
+	delete_threads();
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <string>
+
+
+// ns/op of the hot-path primitives over the bench positions (or those in fen_file)
+void run_microbench(const int n_rounds, const std::string & fen_file);
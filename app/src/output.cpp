@@ -0,0 +1,150 @@
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <optional>
+#include <string>
+#include <libchess/Position.h>
+#include <libchess/UCIService.h>
+#if !defined(ESP32)
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#endif
+
+#include "main.h"
+#include "output.h"
+#include "tt.h"
+
+
+static void print_info(const uci_info_t & info)
+{
+	int hashfull = tti.get_per_mille_filled();
+
+	if (info.interrupted) {
+		printf("info depth %d score cp %d hashfull %d\n", info.depth, info.score, hashfull);
+		return;
+	}
+
+	std::string pv_str;
+	for(auto & move : info.pv)
+		pv_str += " " + move.to_str();
+
+	std::string ebf_str = info.ebf >= 0 ? "ebf " + std::to_string(info.ebf) + " " : "";
+
+	uint64_t use_time_ms = std::max(uint64_t(1), info.time_ms);  // prevent div. by 0
+	uint64_t nps         = info.nodes * 1000 / use_time_ms;
+
+	if (abs(info.score) > 9800) {
+		int mate_moves = (10000 - abs(info.score) + 1) / 2 * (info.score < 0 ? -1 : 1);
+		printf("info depth %d score mate %d nodes %" PRIu64 " %stime %" PRIu64 " nps %" PRIu64 " tbhits %" PRIu64 " hashfull %d pv%s\n",
+				info.depth, mate_moves, info.nodes, ebf_str.c_str(), info.time_ms, nps, info.tb_hits, hashfull, pv_str.c_str());
+	}
+	else {
+		printf("info depth %d score cp %d nodes %" PRIu64 " %stime %" PRIu64 " nps %" PRIu64 " tbhits %" PRIu64 " hashfull %d pv%s\n",
+				info.depth, info.score, info.nodes, ebf_str.c_str(), info.time_ms, nps, info.tb_hits, hashfull, pv_str.c_str());
+	}
+}
+
+#if defined(ESP32)
+// no writer thread: the UART driver already buffers
+void output_info(uci_info_t && info)
+{
+	print_info(info);
+}
+
+void output_bestmove(const std::string & move, const std::optional<std::string> & ponder_move)
+{
+	libchess::UCIService::bestmove(move, ponder_move);
+	fflush(stdout);
+}
+
+void output_stop()
+{
+}
+#else
+static struct {
+	std::mutex              lock;
+	std::condition_variable cv;
+	std::deque<uci_info_t>  queue;
+	std::thread            *th   { nullptr };
+	bool                    quit { false   };
+
+	std::mutex              write_lock;  // one line at a time on stdout
+} output;
+
+static void writer_thread()
+{
+	std::unique_lock<std::mutex> lck(output.lock);
+
+	for(;;) {
+		output.cv.wait(lck, [] { return output.queue.empty() == false || output.quit; });
+		if (output.queue.empty())  // quit
+			break;
+
+		uci_info_t info = std::move(output.queue.front());
+		output.queue.pop_front();
+
+		// the write lock is taken before the queue is released: a bestmove in
+		// between finds the queue empty and this line printed
+		std::unique_lock<std::mutex> write_lck(output.write_lock);
+		lck.unlock();
+
+		print_info(info);
+		write_lck.unlock();
+
+		lck.lock();
+	}
+}
+
+void output_info(uci_info_t && info)
+{
+	std::unique_lock<std::mutex> lck(output.lock);
+
+	if (!output.th)
+		output.th = new std::thread(writer_thread);
+
+	output.queue.push_back(std::move(info));
+	output.cv.notify_one();
+}
+
+void output_bestmove(const std::string & move, const std::optional<std::string> & ponder_move)
+{
+	std::unique_lock<std::mutex> lck(output.lock);
+	// only the newest line (the final score and pv) is printed, the older ones
+	// would delay bestmove on a slow pipe
+	std::optional<uci_info_t> last;
+	if (output.queue.empty() == false)
+		last = std::move(output.queue.back());
+	output.queue.clear();
+
+	// at most a line that is being written is waited for
+	std::unique_lock<std::mutex> write_lck(output.write_lock);
+	lck.unlock();
+
+	if (last.has_value())
+		print_info(last.value());
+
+	libchess::UCIService::bestmove(move, ponder_move);
+	fflush(stdout);
+}
+
+void output_stop()
+{
+	std::unique_lock<std::mutex> lck(output.lock);
+	if (!output.th)
+		return;
+
+	output.quit = true;
+	output.cv.notify_one();
+	lck.unlock();
+
+	output.th->join();
+
+	lck.lock();
+	delete output.th;
+	output.th   = nullptr;
+	output.quit = false;
+}
+#endif
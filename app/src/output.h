@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+#include <libchess/Position.h>
+
+
+// "info" lines of the search: thread 0 only posts them, a writer thread formats
+// and prints them so that a slow GUI pipe does not stall the search
+typedef struct {
+	int      depth       { 0     };
+	int      score       { 0     };
+	bool     interrupted { false };  // only depth, score and hashfull
+	uint64_t nodes       { 0     };
+	uint64_t tb_hits     { 0     };
+	uint64_t time_ms     { 0     };
+	double   ebf         { -1.   };  // < 0: unknown
+	std::vector<libchess::Move> pv;
+} uci_info_t;
+
+void output_info(uci_info_t && info);
+// of the info lines that are still queued only the newest is printed, before bestmove
+void output_bestmove(const std::string & move, const std::optional<std::string> & ponder_move);
+void output_stop();
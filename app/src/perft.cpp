@@ -0,0 +1,222 @@
+#include <algorithm>
+#include <atomic>
+#include <cinttypes>
+#include <thread>
+#include <libchess/Position.h>
+
+#include "main.h"
+#include "perft.h"
+#include "tui.h"
+
+
+// entries are checked with key ^ count so that torn writes are detected (as in
+// the TT); the depth is part of the key
+class perft_tt
+{
+private:
+	typedef struct {
+		std::atomic<uint64_t> check;
+		std::atomic<uint64_t> count;
+	} perft_entry;
+
+	perft_entry *entries   { nullptr };
+	uint64_t     n_entries { 0       };
+
+	static uint64_t key(const uint64_t hash, const int depth) {
+		return hash ^ (uint64_t(depth) * 0x9e3779b97f4a7c15ull);
+	}
+
+public:
+	perft_tt(const uint64_t size) : n_entries(std::max(uint64_t(1), size / sizeof(perft_entry))) {
+		entries = new perft_entry[n_entries]();
+	}
+
+	~perft_tt() {
+		delete [] entries;
+	}
+
+	bool lookup(const uint64_t hash, const int depth, uint64_t *const count) const {
+		uint64_t     k     = key(hash, depth);
+		perft_entry &e     = entries[k % n_entries];
+		uint64_t     check = e.check.load(std::memory_order_relaxed);
+		uint64_t     c     = e.count.load(std::memory_order_relaxed);
+
+		if ((check ^ c) != k || c == 0)
+			return false;
+
+		*count = c;
+		return true;
+	}
+
+	void store(const uint64_t hash, const int depth, const uint64_t count) {
+		uint64_t     k = key(hash, depth);
+		perft_entry &e = entries[k % n_entries];
+		e.check.store(k ^ count, std::memory_order_relaxed);
+		e.count.store(count,     std::memory_order_relaxed);
+	}
+};
+
+static uint64_t do_perft(libchess::Position & pos, const int depth, perft_tt *const tt)
+{
+	if (depth == 1)
+		return pos.legal_move_list().size();
+
+	uint64_t count = 0;
+	if (tt && tt->lookup(pos.hash(), depth, &count))
+		return count;
+
+	for(const libchess::Move & move: pos.legal_move_list()) {
+		pos.make_move(move);
+		count += do_perft(pos, depth - 1, tt);
+		pos.unmake_move();
+	}
+
+	if (tt)
+		tt->store(pos.hash(), depth, count);
+
+	return count;
+}
+
+// one table per command: the depth is part of the key, so it stays valid for all depths and positions
+static perft_tt *create_perft_tt(const perft_parameters_t & pars)
+{
+	return pars.hash_mb > 0 ? new perft_tt(uint64_t(pars.hash_mb) * 1024 * 1024) : nullptr;
+}
+
+// the root moves are handed out to the threads one at a time
+static std::vector<std::pair<libchess::Move, uint64_t> > perft_divide_counts(const libchess::Position & pos, const int depth, const int n_threads, perft_tt *const tt)
+{
+	std::vector<std::pair<libchess::Move, uint64_t> > out;
+	for(auto & move: pos.legal_move_list())
+		out.push_back({ move, 1 });
+
+	if (depth <= 1)
+		return out;
+
+	std::atomic_size_t next { 0 };
+
+	auto worker = [&]() {
+		libchess::Position work = pos;
+
+		for(;;) {
+			size_t index = next++;
+			if (index >= out.size())
+				break;
+
+			work.make_move(out[index].first);
+			out[index].second = do_perft(work, depth - 1, tt);
+			work.unmake_move();
+		}
+	};
+
+	std::vector<std::thread *> threads;
+	for(int i=1; i<n_threads; i++)
+		threads.push_back(new std::thread(worker));
+
+	worker();
+
+	for(auto & th: threads) {
+		th->join();
+		delete th;
+	}
+
+	return out;
+}
+
+std::vector<std::pair<libchess::Move, uint64_t> > perft_divide_counts(const libchess::Position & pos, const int depth, const perft_parameters_t & pars)
+{
+	perft_tt *tt  = create_perft_tt(pars);
+	auto      out = perft_divide_counts(pos, depth, pars.n_threads, tt);
+	delete tt;
+
+	return out;
+}
+
+static uint64_t perft_count(const libchess::Position & pos, const int depth, const int n_threads, perft_tt *const tt)
+{
+	uint64_t count = 0;
+	for(auto & entry: perft_divide_counts(pos, depth, n_threads, tt))
+		count += entry.second;
+
+	return count;
+}
+
+void perft(libchess::Position & pos, const int depth, const perft_parameters_t & pars)
+{
+	my_printf("Perft for fen: %s\n", pos.fen().c_str());
+
+	perft_tt *tt = create_perft_tt(pars);
+
+	for(int d=1; d<=depth; d++) {
+		uint64_t t_start = esp_timer_get_time();
+		uint64_t count   = perft_count(pos, d, pars.n_threads, tt);
+		uint64_t t_end   = esp_timer_get_time();
+		double   t_diff  = std::max(uint64_t(1), t_end - t_start) / 1000000.;
+		my_printf("%d: %" PRIu64 " (%.3f nps, %.2f seconds)\n", d, count, count / t_diff, t_diff);
+	}
+
+	delete tt;
+}
+
+void perft_divide(const libchess::Position & pos, const int depth, const perft_parameters_t & pars)
+{
+	uint64_t t_start = esp_timer_get_time();
+	auto     counts  = perft_divide_counts(pos, depth, pars);
+	uint64_t t_end   = esp_timer_get_time();
+
+	uint64_t total = 0;
+	for(auto & entry: counts) {
+		my_printf("%s: %" PRIu64 "\n", entry.first.to_str().c_str(), entry.second);
+		total += entry.second;
+	}
+
+	double t_diff = std::max(uint64_t(1), t_end - t_start) / 1000000.;
+	my_printf("\nMoves: %zu, nodes: %" PRIu64 " (%.3f nps, %.2f seconds)\n", counts.size(), total, total / t_diff, t_diff);
+}
+
+// https://www.chessprogramming.org/Perft_Results
+static const struct {
+	const char *fen;
+	std::vector<uint64_t> counts;  // depth 1, 2, ...
+} perft_positions[] {
+	{ "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",                { 20, 400, 8902, 197281, 4865609, 119060324 } },
+	{ "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",    { 48, 2039, 97862, 4085603, 193690690 } },
+	{ "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",                               { 14, 191, 2812, 43238, 674624, 11030083 } },
+	{ "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",        { 6, 264, 9467, 422333, 15833292 } },
+	{ "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",               { 44, 1486, 62379, 2103487, 89941194 } },
+	{ "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P3/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", { 46, 2079, 89890, 3894594, 164075551 } },
+};
+
+bool perft_suite(const int max_depth, const perft_parameters_t & pars)
+{
+	bool      ok      = true;
+	uint64_t  total   = 0;
+	perft_tt *tt      = create_perft_tt(pars);
+	uint64_t  t_start = esp_timer_get_time();
+
+	for(auto & p: perft_positions) {
+		libchess::Position pos { p.fen };
+
+		bool position_ok = true;
+		int  depth       = std::min(max_depth, int(p.counts.size()));
+		for(int d=1; d<=depth; d++) {
+			uint64_t count    = perft_count(pos, d, pars.n_threads, tt);
+			uint64_t expected = p.counts.at(d - 1);
+			total += count;
+
+			if (count != expected) {
+				my_printf("FAIL %s depth %d: %" PRIu64 " instead of %" PRIu64 "\n", p.fen, d, count, expected);
+				position_ok = false;
+			}
+		}
+
+		my_printf("%s %s (depth %d)\n", position_ok ? "ok  " : "FAIL", p.fen, depth);
+		ok &= position_ok;
+	}
+
+	double t_diff = std::max(uint64_t(1), esp_timer_get_time() - t_start) / 1000000.;
+	delete tt;
+	my_printf("%s: %" PRIu64 " nodes (%.3f nps, %.2f seconds)\n", ok ? "All counts match" : "MISMATCH", total, total / t_diff, t_diff);
+
+	return ok;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <libchess/Position.h>
+
+
+typedef struct {
+	int n_threads { 1 };
+	int hash_mb   { 0 };  // 0: no perft TT
+} perft_parameters_t;
+
+// per root move, in move generation order
+std::vector<std::pair<libchess::Move, uint64_t> > perft_divide_counts(const libchess::Position & pos, const int depth, const perft_parameters_t & pars);
+
+void perft       (libchess::Position & pos, const int depth, const perft_parameters_t & pars = { });
+void perft_divide(const libchess::Position & pos, const int depth, const perft_parameters_t & pars);
+// returns false when a count does not match
+bool perft_suite (const int max_depth, const perft_parameters_t & pars);
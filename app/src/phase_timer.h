@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+
+
+// where the time inside the search goes; only when built with PHASE_TIMERS=1 (see
+// the CMakeLists.txt), else the timers are compiled out entirely
+typedef enum { PHASE_EVAL, PHASE_MOVEGEN, PHASE_SORT, PHASE_TT, PHASE_LEGALITY, PHASE_SEARCH, PHASE_N } phase_t;
+
+#if defined(WITH_PHASE_TIMERS)
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+
+// cycles
+inline uint64_t phase_clock()
+{
+	return __rdtsc();
+}
+#else
+#include <chrono>
+
+// nanoseconds
+inline uint64_t phase_clock()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+class phase_timer
+{
+private:
+	uint64_t &     target;
+	const uint64_t start;
+
+public:
+	phase_timer(uint64_t & target) : target(target), start(phase_clock()) {
+	}
+
+	~phase_timer() {
+		target += phase_clock() - start;
+	}
+};
+
+#define PHASE_TIMER_NAME2(line) phase_timer_ ## line
+#define PHASE_TIMER_NAME(line)  PHASE_TIMER_NAME2(line)
+// measures until the end of the enclosing scope
+#define PHASE_TIMER(cs, phase)  phase_timer PHASE_TIMER_NAME(__LINE__)((cs).data.phase_ticks[phase])
+#else
+#define PHASE_TIMER(cs, phase)  (void)(cs)
+#endif
@@ -10,7 +10,9 @@
 #include "eval.h"
 #include "inbuf.h"
 #include "main.h"
+#include "material.h"
 #include "max-ascii.h"
+#include "output.h"
 #include "psq.h"
 #include "search.h"
 #include "str.h"
@@ -18,6 +20,8 @@
 #include "syzygy.h"
 #endif
 #include "test.h"
+#include "timemanager.h"
+#include "treerec.h"
 #include "tt.h"
 #include "tui.h"
 
@@ -40,6 +44,90 @@ for(int depth=1; depth<N_LMR_DEPTH; depth++) {
 #endif
 }
 
+pruning_parameters_t pruning_parameters {
+	true, 4, { 0, 125, 225, 325, 425, 0, 0, 0, 0 },
+	true, 6, { { 0, 3, 5, 8, 12, 17, 23, 0, 0 }, { 0, 5, 8, 12, 17, 23, 30, 0, 0 } },
+	true, 3, 300
+};
+
+smp_mode_t smp_mode = SMP_LAZY;
+
+std::optional<smp_mode_t> smp_mode_from_string(const std::string & name)
+{
+	if (name == "lazy")
+		return SMP_LAZY;
+#if !defined(ESP32)
+	if (name == "abdada")
+		return SMP_ABDADA;
+#endif
+	if (name == "rootsplit")
+		return SMP_ROOTSPLIT;
+
+	return { };
+}
+
+const char *smp_mode_name(const smp_mode_t mode)
+{
+	if (mode == SMP_ABDADA)
+		return "abdada";
+	if (mode == SMP_ROOTSPLIT)
+		return "rootsplit";
+
+	return "lazy";
+}
+
+constexpr int abdada_min_depth   = 3;
+
+#if !defined(ESP32)
+// simplified ABDADA (as in Tom Kerrigan's description): a small table of position/move hashes
+// that are being searched right now; no locking, a lost update only costs some duplicate work
+constexpr int n_abdada_entries   = 32768;
+static std::atomic<uint64_t> abdada_table[n_abdada_entries];
+
+static uint64_t abdada_move_hash(const uint64_t hash, const libchess::Move move)
+{
+	return hash ^ (uint64_t(move.value()) * 0x9e3779b97f4a7c15ll);
+}
+
+static bool abdada_is_searching(const uint64_t move_hash)
+{
+	return abdada_table[move_hash % n_abdada_entries].load(std::memory_order_relaxed) == move_hash;
+}
+
+static void abdada_start(const uint64_t move_hash)
+{
+	auto & entry = abdada_table[move_hash % n_abdada_entries];
+	if (entry.load(std::memory_order_relaxed) == 0)
+		entry.store(move_hash, std::memory_order_relaxed);
+}
+
+static void abdada_finish(const uint64_t move_hash)
+{
+	auto & entry = abdada_table[move_hash % n_abdada_entries];
+	if (entry.load(std::memory_order_relaxed) == move_hash)
+		entry.store(0, std::memory_order_relaxed);
+}
+#else
+// the table does not fit in the DRAM and with at most 2 threads there is little to share
+static uint64_t abdada_move_hash(const uint64_t, const libchess::Move)
+{
+	return 0;
+}
+
+static bool abdada_is_searching(const uint64_t)
+{
+	return false;
+}
+
+static void abdada_start(const uint64_t)
+{
+}
+
+static void abdada_finish(const uint64_t)
+{
+}
+#endif
+
 inline int history_index(const libchess::Color & side, const libchess::PieceType & from_type, const libchess::Square & sq)
 {
 	return side * 6 * 64 + from_type * 64 + sq;
@@ -159,6 +247,175 @@ bool is_insufficient_material_draw(const libchess::Position & pos)
         return true;
 }
 
+// keeps the material key in sync with the position
+static void make_move(search_pars_t & sp, const libchess::Move & move)
+{
+	material_key_t key  = sp.stack[sp.ply].material_key;
+	libchess::Color stm = sp.pos.side_to_move();
+
+	if (sp.pos.is_capture_move(move)) {
+		if (move.type() == libchess::Move::Type::ENPASSANT)
+			key -= material_delta(!stm, libchess::constants::PAWN);
+		else
+			key -= material_delta(!stm, sp.pos.piece_type_on(move.to_square()).value());
+	}
+
+	if (sp.pos.is_promotion_move(move)) {
+		key -= material_delta(stm, libchess::constants::PAWN);
+		key += material_delta(stm, move.promotion_piece_type().value());
+	}
+
+	sp.pos.make_move(move);
+	sp.ply++;
+	sp.stack[sp.ply].material_key  = key;
+	sp.stack[sp.ply].excluded_move = libchess::Move(0);
+}
+
+static void make_null_move(search_pars_t & sp)
+{
+	sp.pos.make_null_move();
+	sp.ply++;
+	sp.stack[sp.ply].material_key  = sp.stack[sp.ply - 1].material_key;
+	sp.stack[sp.ply].excluded_move = libchess::Move(0);
+}
+
+static void unmake_move(search_pars_t & sp)
+{
+	sp.pos.unmake_move();
+	sp.ply--;
+}
+
+static bool is_draw_by_material(const search_pars_t & sp)
+{
+	return is_material_draw(sp.stack[sp.ply].material_key, sp.pos);
+}
+
+// NNUE output, scaled down for drawish material
+static int evaluate(search_pars_t & sp)
+{
+	PHASE_TIMER(sp.cs, PHASE_EVAL);
+	material_entry e = probe_material(sp.stack[sp.ply].material_key);
+	if (e.bishop_colors && is_draw_by_material(sp))
+		return 0;
+
+	int score = nnue_evaluate(sp.pos);
+	return score * e.scale / material_scale_unity;
+}
+
+static std::optional<tt_entry> tt_lookup(search_pars_t & sp, const uint64_t hash)
+{
+	PHASE_TIMER(sp.cs, PHASE_TT);
+	return tti.lookup(hash);
+}
+
+static bool is_legal(search_pars_t & sp, const libchess::Move move)
+{
+	PHASE_TIMER(sp.cs, PHASE_LEGALITY);
+	return sp.pos.is_legal_generated_move(move);
+}
+
+// index < 0: no cut-off
+static void record_node(const search_pars_t & sp, const int depth, const int alpha, const int beta, const int score, const libchess::Move move, const tree_decision_t decision, const int index, const bool tt_hit)
+{
+	tree_record_t r { };
+	r.move      = move.value();
+	r.alpha     = alpha;
+	r.beta      = beta;
+	r.score     = score;
+	r.ply       = std::min(sp.ply, 255);
+	r.depth     = depth;
+	r.kind      = TREC_NODE;
+	r.node_type = score >= beta ? NODE_CUT : (score <= alpha ? NODE_ALL : NODE_PV);
+	r.decision  = decision;
+	r.index     = index < 0 ? trec_no_index : std::min(index, trec_no_index - 1);
+	r.flags     = tt_hit ? trec_tt_hit : 0;
+	r.thread_nr = sp.thread_nr;
+	tree_record(r);
+}
+
+static void record_lmr(const search_pars_t & sp, const int depth, const int move_nr, const libchess::Move move, const bool re_search)
+{
+	tree_record_t r { };
+	r.move      = move.value();
+	r.ply       = std::min(sp.ply, 255);
+	r.depth     = depth;
+	r.kind      = TREC_LMR;
+	r.index     = std::min(move_nr, trec_no_index - 1);
+	r.flags     = re_search ? trec_lmr_re_search : 0;
+	r.thread_nr = sp.thread_nr;
+	tree_record(r);
+}
+
+constexpr int see_piece_values[] = { 100, 300, 300, 500, 900, 10000 };
+
+static int captured_value(const libchess::Position & pos, const libchess::Move move)
+{
+	if (move.type() == libchess::Move::Type::ENPASSANT)
+		return see_piece_values[libchess::constants::PAWN];
+
+	auto piece_to = pos.piece_type_on(move.to_square());
+	return piece_to.has_value() ? see_piece_values[piece_to.value()] : 0;
+}
+
+// static exchange evaluation by swapping off the attackers of the target square (no x-rays)
+int see(const libchess::Position & pos, const libchess::Move move)
+{
+	using namespace libchess::constants;
+
+	const libchess::Square to   = move.to_square();
+	const libchess::Square from = move.from_square();
+
+	int gain[32] { };
+	gain[0]       = captured_value(pos, move);
+	int on_square = see_piece_values[pos.piece_type_on(from).value()];
+
+	if (move.promotion_piece_type().has_value()) {
+		int promotion_value = see_piece_values[move.promotion_piece_type().value()];
+		gain[0]  += promotion_value - see_piece_values[PAWN];
+		on_square = promotion_value;
+	}
+
+	libchess::Color side         = pos.side_to_move();
+	uint64_t        attackers[2] { pos.attackers_to(to, WHITE), pos.attackers_to(to, BLACK) };
+	attackers[side] &= ~(uint64_t(1) << from);
+	side = !side;
+
+	int d = 0;
+	while(attackers[side] && d < 31) {
+		// least valuable attacker
+		uint64_t attacker_bb    = 0;
+		int      attacker_value = 0;
+		for(libchess::PieceType t : { PAWN, KNIGHT, BISHOP, ROOK, QUEEN, KING }) {
+			uint64_t bb = attackers[side] & pos.piece_type_bb(t, side);
+			if (bb) {
+				attacker_bb    = bb & -bb;
+				attacker_value = see_piece_values[t];
+				break;
+			}
+		}
+
+		// the king cannot capture into a defended square
+		if (attacker_value == see_piece_values[KING] && attackers[!side])
+			break;
+
+		d++;
+		gain[d] = on_square - gain[d - 1];
+		if (std::max(-gain[d - 1], gain[d]) < 0)
+			break;
+
+		attackers[side] &= ~attacker_bb;
+		on_square = attacker_value;
+		side      = !side;
+	}
+
+	while(d > 0) {
+		gain[d - 1] = -std::max(-gain[d - 1], gain[d]);
+		d--;
+	}
+
+	return gain[0];
+}
+
 libchess::MoveList gen_qs_moves(libchess::Position & pos)
 {
 	libchess::Color side = pos.side_to_move();
@@ -173,6 +430,29 @@ libchess::MoveList gen_qs_moves(libchess::Position & pos)
 	return ml;
 }
 
+typedef struct
+{
+	libchess::Move move;
+	int            score;
+} scored_move_t;
+
+// selection instead of a full sort: in qs most cut-offs happen on the first or second capture
+static std::optional<libchess::Move> pick_next_move(std::vector<scored_move_t> & moves, size_t & index)
+{
+	if (index >= moves.size())
+		return { };
+
+	size_t best = index;
+	for(size_t i=index + 1; i<moves.size(); i++) {
+		if (moves[i].score > moves[best].score)
+			best = i;
+	}
+
+	std::swap(moves[index], moves[best]);
+
+	return moves[index++].move;
+}
+
 int qs(int alpha, const int beta, const int qsdepth, search_pars_t & sp)
 {
 	if (sp.stop->flag)
@@ -186,11 +466,15 @@ int qs(int alpha, const int beta, const int qsdepth, search_pars_t & sp)
 	}
 #endif
 	if (qsdepth >= 127)
-		return nnue_evaluate(sp.pos);
+		return evaluate(sp);
 
 	sp.cs.data.qnodes++;
+	if ((sp.cs.data.qnodes & 1023) == 0) {
+		publish_statistics(sp);
+		lockstep_yield(sp);
+	}
 
-	if (sp.pos.halfmoves() >= 100 || sp.pos.is_repeat() || is_insufficient_material_draw(sp.pos))
+	if (sp.pos.halfmoves() >= 100 || sp.pos.is_repeat() || is_draw_by_material(sp))
 		return 0;
 
 	int  best_score = -32767;
@@ -198,70 +482,96 @@ int qs(int alpha, const int beta, const int qsdepth, search_pars_t & sp)
 	bool in_check   = sp.pos.in_check();
 	if (!in_check) {
 		// standing pat
-		best_score = nnue_evaluate(sp.pos);
+		best_score = evaluate(sp);
 		if (best_score > alpha && best_score >= beta) {
-			sp.cs.data.n_standing_pat++;
+			sp.cs.count(sp.cs.data.n_standing_pat);
+			return best_score;
+		}
+
+		// delta pruning: not even capturing a queen (or promoting) gets us to alpha
+		constexpr uint64_t rank_7[] = { 0x00ff000000000000ll, 0x000000000000ff00ll };
+		int big_delta = see_piece_values[libchess::constants::QUEEN];
+		if (sp.pos.piece_type_bb(libchess::constants::PAWN, sp.pos.side_to_move()) & rank_7[sp.pos.side_to_move()])
+			big_delta += see_piece_values[libchess::constants::QUEEN] - see_piece_values[libchess::constants::PAWN];
+		if (best_score + big_delta < alpha) {
+			sp.cs.count(sp.cs.data.n_qs_early_stop);
 			return best_score;
 		}
-/* TODO
-		int BIG_DELTA = sp.parameters.big_delta;
-		if (sp.pos.previous_move().has_value() && sp.pos.is_promotion_move(sp.pos.previous_move().value()))
-			BIG_DELTA += sp.parameters.big_delta_promotion;
-		if (best_score < alpha - BIG_DELTA)
-			return alpha;
-*/
+
 		if (alpha < best_score)
 			alpha = best_score;
 	}
 
-	int  n_played  = 0;
-	auto move_list = gen_qs_moves(sp.pos);
+	// only used for move ordering
+	std::optional<tt_entry> te = tt_lookup(sp, sp.pos.hash());
 
 	sort_movelist_compare smc(sp);
-	sort_movelist(move_list, smc);
+	if (te.has_value() && te.value().m)
+		smc.add_first_move(libchess::Move(te.value().m));
+
+	// when in check these are all evasions, ordered tt-move, captures (MVV-LVA), then history
+	libchess::MoveList move_list;
+	{
+		PHASE_TIMER(sp.cs, PHASE_MOVEGEN);
+		move_list = gen_qs_moves(sp.pos);
+	}
 
-	for(auto move : move_list) {
-		if (sp.pos.is_legal_generated_move(move) == false)
+	std::vector<scored_move_t> moves;
+	moves.reserve(move_list.size());
+	{
+		PHASE_TIMER(sp.cs, PHASE_SORT);
+		for(auto move : move_list)
+			moves.push_back({ move, smc.move_evaluater(move) });
+	}
+
+	constexpr int qs_futility_margin = 200;
+
+	int    n_played = 0;
+	size_t index    = 0;
+	for(;;) {
+		auto next = pick_next_move(moves, index);
+		if (next.has_value() == false)
+			break;
+		libchess::Move move = next.value();
+
+		if (is_legal(sp, move) == false)
 			continue;
 
-		if (!in_check && sp.pos.is_capture_move(move)) {
-			auto piece_to    = sp.pos.piece_on(move.to_square());
-			int  eval_target = move.type() == libchess::Move::Type::ENPASSANT ? libchess::constants::PAWN : piece_to->type();
-			auto piece_from  = sp.pos.piece_on(move.from_square());
-			int  eval_killer = piece_from->type();
-			if (eval_killer > eval_target && sp.pos.attackers_to(move.to_square(), !sp.pos.side_to_move()))
+		if (!in_check) {
+			// captures that lose material or that cannot get near alpha
+			if (see(sp.pos, move) < 0 ||
+			    (!sp.pos.is_promotion_move(move) && best_score + captured_value(sp.pos, move) + qs_futility_margin <= alpha)) {
+				sp.cs.count(sp.cs.data.n_qs_early_stop);
 				continue;
+			}
 		}
 
 		n_played++;
 
-		sp.pos.make_move(move);
+		make_move(sp, move);
 		int score = -qs(-beta, -alpha, qsdepth + 1, sp);
-		sp.pos.unmake_move();
+		unmake_move(sp);
 
 		if (score > best_score) {
 			best_score = score;
 
 			if (score > alpha) {
 				if (score >= beta) {
-					sp.cs.data.n_qmoves_cutoff += n_played;
-					sp.cs.data.nmc_qnodes++;
+					sp.cs.count(sp.cs.data.n_qmoves_cutoff, n_played);
+					sp.cs.count(sp.cs.data.nmc_qnodes);
 					break;
 				}
 
 				alpha = score;
 			}
 		}
-
-		if (n_played >= 3 && best_score >= 9800)
-			break;
 	}
 
 	if (n_played == 0) {
 		if (in_check)
 			best_score = -10000 + qsdepth;
 		else if (best_score == -32767)
-			best_score = nnue_evaluate(sp.pos);
+			best_score = evaluate(sp);
 	}
 
 	assert(best_score >= -10000);
@@ -270,7 +580,7 @@ int qs(int alpha, const int beta, const int qsdepth, search_pars_t & sp)
 	return best_score;
 }
 
-void update_history(const search_pars_t & sp, const int index, const int bonus)
+void update_history(search_pars_t & sp, const int index, const int bonus)
 {
 	constexpr const int max_history = 1023;
 	constexpr const int min_history = -max_history;
@@ -301,28 +611,41 @@ int search(int depth, int16_t alpha, const int16_t beta, const int null_move_dep
 #endif
 
 	sp.cs.data.nodes++;
+	if ((sp.cs.data.nodes & 1023) == 0) {
+		publish_statistics(sp);
+		lockstep_yield(sp);
+	}
 
 	bool is_root_position = max_depth == depth;
-	if (!is_root_position && (sp.pos.is_repeat() || is_insufficient_material_draw(sp.pos))) {
-		sp.cs.data.n_draws++;
+	if (!is_root_position && (sp.pos.is_repeat() || is_draw_by_material(sp))) {
+		sp.cs.count(sp.cs.data.n_draws);
 		return 0;
 	}
 
+	// extensions can make lines longer than max_depth; leave room for qs
+	if (sp.ply >= max_search_ply / 2)
+		return evaluate(sp);
+
 	const int  start_alpha = alpha;
 	const bool is_pv       = alpha != beta -1;
 
+	// when set, this is a search verifying if that move is singular
+	const libchess::Move excluded_move = sp.stack[sp.ply].excluded_move;
+	const bool           is_excluded   = excluded_move.value() != 0;
+
 	// TT //
 	std::optional<libchess::Move> tt_move { };
 	uint64_t       hash        = sp.pos.hash();
-	std::optional<tt_entry> te = tti.lookup(hash);
+	std::optional<tt_entry> te = tt_lookup(sp, hash);
 	sp.cs.data.tt_query++;
+	const bool     record      = tree_record_sampled(hash);
 
         if (te.has_value()) {  // TT hit?
 		sp.cs.data.tt_hit++;
 		if (te.value().m)  // move stored in TT?
 			tt_move = libchess::Move(te.value().m);
 
-		if (te.value().depth >= depth && !is_pv) {
+		if (te.value().depth >= depth && !is_pv && !is_excluded) {
 			int score      = te.value().score;
 			int work_score = eval_from_tt(score, csd);
 			auto flag      = te.value().flags;
@@ -335,18 +658,24 @@ int search(int depth, int16_t alpha, const int16_t beta, const int null_move_dep
 					if (is_root_position) {
 						if (sp.pos.is_legal_move(tt_move.value())) {
 							*m = tt_move.value();  // move in TT is valid
+							if (record)
+								record_node(sp, depth, alpha, beta, work_score, *m, DEC_TT_CUTOFF, -1, true);
 							return work_score;
 						}
 
-						sp.cs.data.tt_invalid++; // move stored in TT is not valid - TT-collision
+						sp.cs.count(sp.cs.data.tt_invalid); // move stored in TT is not valid - TT-collision
 						// do NOT return
 					}
 					else {
 						*m = tt_move.value();  // not used directly, only for move ordening
+						if (record)
+							record_node(sp, depth, alpha, beta, work_score, *m, DEC_TT_CUTOFF, -1, true);
 						return work_score;
 					}
 				}
 				else if (!is_root_position) {
+					if (record)
+						record_node(sp, depth, alpha, beta, work_score, libchess::Move(0), DEC_TT_CUTOFF, -1, true);
 					return work_score;
 				}
 			}
@@ -358,7 +687,7 @@ int search(int depth, int16_t alpha, const int16_t beta, const int null_move_dep
 	////////
 
 #if defined(linux) || defined(_WIN32) || defined(__ANDROID__) || defined(__APPLE__)
-	if (with_syzygy && !is_root_position) {
+	if (with_syzygy && !is_root_position && !is_excluded) {
 		// check piece count
 		unsigned counts = sp.pos.occupancy_bb().popcount();
 
@@ -369,10 +698,13 @@ int search(int depth, int16_t alpha, const int16_t beta, const int null_move_dep
 
 			if (syzygy_score.has_value()) {
 				sp.cs.data.syzygy_query_hits++;
-				sp.cs.data.tt_store++;
+				sp.cs.count(sp.cs.data.tt_store);
 
 				int score      = syzygy_score.value();
 				int work_score = eval_to_tt(score, csd);
+				if (record)
+					record_node(sp, depth, alpha, beta, score, libchess::Move(0), DEC_SYZYGY, -1, te.has_value());
+				PHASE_TIMER(sp.cs, PHASE_TT);
 				tti.store(hash, EXACT, depth, work_score, libchess::Move(0));
 				return score;
 			}
@@ -381,47 +713,88 @@ int search(int depth, int16_t alpha, const int16_t beta, const int null_move_dep
 #endif
 	bool in_check = sp.pos.in_check();
 
-	if (!is_root_position && !in_check && depth <= 7 && beta <= 9800) {
-		sp.cs.data.n_static_eval++;
-		int staticeval = nnue_evaluate(sp.pos);
+	// also evaluated 2 plies above the pruning depths, for "improving"
+	int staticeval = no_static_eval;
+	if (!is_root_position && !in_check && depth <= max_pruning_depth + 2)
+		staticeval = evaluate(sp);
+	sp.stack[sp.ply].static_eval = staticeval;
+
+	bool improving = sp.ply < 2 || sp.stack[sp.ply - 2].static_eval == no_static_eval || staticeval > sp.stack[sp.ply - 2].static_eval;
+
+	if (staticeval != no_static_eval && depth <= 7 && beta <= 9800 && !is_excluded) {
+		sp.cs.count(sp.cs.data.n_static_eval);
 
 		// static null pruning (reverse futility pruning)
 		if (staticeval - depth * 121 > beta) {
-			sp.cs.data.n_static_eval_hit++;
-			return (beta + staticeval) / 2;
+			sp.cs.count(sp.cs.data.n_static_eval_hit);
+			int score = (beta + staticeval) / 2;
+			if (record)
+				record_node(sp, depth, alpha, beta, score, libchess::Move(0), DEC_REVERSE_FUTILITY, -1, te.has_value());
+			return score;
 		}
 	}
 
-#if defined(linux)
-	if (sp.thread_nr == 1) {
-		wboard = sp.pos.color_bb(libchess::constants::WHITE);
-		bboard = sp.pos.color_bb(libchess::constants::BLACK);
-	}
-#endif
-
 	///// null move
 	int nm_reduce_depth = depth > 6 ? 4 : 3;
-	if (depth >= 2 && !in_check && !is_root_position && null_move_depth < 2) {
-		sp.cs.data.n_null_move++;
+	if (depth >= 2 && !in_check && !is_root_position && null_move_depth < 2 && !is_excluded) {
+		sp.cs.count(sp.cs.data.n_null_move);
 
-		sp.pos.make_null_move();
+		make_null_move(sp);
 		libchess::Move ignore { };
 		int nmscore = -search(std::max(0, depth - nm_reduce_depth), -beta, -beta + 1, null_move_depth + 1, max_depth, &ignore, sp);
-		sp.pos.unmake_move();
+		unmake_move(sp);
 
                 if (nmscore >= beta) {
 			libchess::Move ignore2 { };
 			int verification = search(std::max(0, depth - nm_reduce_depth), beta - 1, beta, null_move_depth, max_depth, &ignore2, sp);
 			if (verification >= beta) {
-				sp.cs.data.n_null_move_hit++;
-				return abs(nmscore) >= 9800 ? beta : nmscore;
+				sp.cs.count(sp.cs.data.n_null_move_hit);
+				int score = abs(nmscore) >= 9800 ? beta : nmscore;
+				if (record)
+					record_node(sp, depth, alpha, beta, score, libchess::Move(0), DEC_NULL_MOVE, -1, te.has_value());
+				return score;
 			}
                 }
 	}
 	///////////////
-	
+
+	///// singular extension
+	// https://www.chessprogramming.org/Singular_Extensions
+	int tt_move_extension = 0;
+	if (depth >= 8 && !is_root_position && !is_excluded && tt_move.has_value() && te.value().depth >= depth - 3 &&
+	    te.value().flags != UPPERBOUND && abs(te.value().score) < 9800 && sp.pos.is_legal_move(tt_move.value())) {
+		sp.cs.count(sp.cs.data.n_singular);
+
+		int singular_beta  = eval_from_tt(te.value().score, csd) - depth * 2;
+		int singular_depth = (depth - 1) / 2;
+
+		sp.stack[sp.ply].excluded_move = tt_move.value();
+		libchess::Move ignore { };
+		int score = search(singular_depth, singular_beta - 1, singular_beta, null_move_depth, max_depth, &ignore, sp);
+		sp.stack[sp.ply].excluded_move = libchess::Move(0);
+
+		if (sp.stop->flag)
+			return 0;
+
+		if (score < singular_beta) {  // all other moves are clearly worse
+			sp.cs.count(sp.cs.data.n_singular_ext);
+			tt_move_extension = 1;
+		}
+		else if (singular_beta >= beta) {  // multi-cut: another move fails high as well
+			sp.cs.count(sp.cs.data.n_multi_cut);
+			if (record)
+				record_node(sp, depth, alpha, beta, singular_beta, libchess::Move(0), DEC_MULTI_CUT, -1, true);
+			return singular_beta;
+		}
+	}
+	///////////////
+
 	int                best_score = -32767;
-	libchess::MoveList move_list  = sp.pos.pseudo_legal_move_list();
+	libchess::MoveList move_list;
+	{
+		PHASE_TIMER(sp.cs, PHASE_MOVEGEN);
+		move_list = sp.pos.pseudo_legal_move_list();
+	}
 
 	sort_movelist_compare smc(sp);
 
@@ -430,29 +803,41 @@ int search(int depth, int16_t alpha, const int16_t beta, const int null_move_dep
 	if (m->value() && sp.pos.is_capture_move(*m))
 		smc.add_first_move(*m);
 
-	sort_movelist(move_list, smc);
+	{
+		PHASE_TIMER(sp.cs, PHASE_SORT);
+		sort_movelist(move_list, smc);
+	}
 
 	int     n_played   = 0;
 	int     lmr_start  = !in_check && depth >= 2 ? 4 : 999;
 
 	std::optional<libchess::Move> beta_cutoff_move;
 	libchess::Move new_move { 0 };
-	for(auto move : move_list) {
-		if (sp.pos.is_legal_generated_move(move) == false)
-			continue;
 
-                bool is_lmr = false;
-                int  score  = -10000;
+	// ABDADA: moves that another thread is searching are postponed; the first move never is
+	const bool use_abdada = smp_mode == SMP_ABDADA && depth >= abdada_min_depth;
+
+	// returns true on a beta cut-off
+	auto play_move = [&](const libchess::Move move) {
+		bool is_lmr    = false;
+		int  score     = -10000;
+		int  extension = tt_move_extension && move == tt_move.value() ? 1 : 0;
+
+		uint64_t move_hash = abdada_move_hash(hash, move);
+		if (use_abdada)
+			abdada_start(move_hash);
 
-                sp.pos.make_move(move);
-                if (n_played == 0)
-                        score = -search(depth - 1, -beta, -alpha, null_move_depth, max_depth, &new_move, sp);
-                else {
-                        int new_depth = depth - 1;
+		uint32_t nodes_before = sp.cs.data.nodes + sp.cs.data.qnodes;
 
-                        if (n_played >= lmr_start && !sp.pos.is_capture_move(move) && !sp.pos.is_promotion_move(move)) {
-                                is_lmr = true;
-				sp.cs.data.n_lmr++;
+		make_move(sp, move);
+		if (n_played == 0)
+			score = -search(depth - 1 + extension, -beta, -alpha, null_move_depth, max_depth, &new_move, sp);
+		else {
+			int new_depth = depth - 1 + extension;
+
+			if (n_played >= lmr_start && !sp.pos.is_capture_move(move) && !sp.pos.is_promotion_move(move)) {
+				is_lmr = true;
+				sp.cs.count(sp.cs.data.n_lmr);
 
 				if (alpha == beta -1) {
 #if defined(ESP32)
@@ -471,15 +856,21 @@ int search(int depth, int16_t alpha, const int16_t beta, const int null_move_dep
 				}
 			}
 
-                        score = -search(new_depth, -alpha - 1, -alpha, null_move_depth, max_depth, &new_move, sp);
+			score = -search(new_depth, -alpha - 1, -alpha, null_move_depth, max_depth, &new_move, sp);
 
-                        if (is_lmr && score > alpha)
-                                score = -search(depth -1, -alpha - 1, -alpha, null_move_depth, max_depth, &new_move, sp);
+			if (is_lmr && record)
+				record_lmr(sp, depth, n_played, move, score > alpha);
 
-                        if (score > alpha && score < beta)
-                                score = -search(depth - 1, -beta, -alpha, null_move_depth, max_depth, &new_move, sp);
-                }
-                sp.pos.unmake_move();
+			if (is_lmr && score > alpha)
+				score = -search(depth -1 + extension, -alpha - 1, -alpha, null_move_depth, max_depth, &new_move, sp);
+
+			if (score > alpha && score < beta)
+				score = -search(depth - 1 + extension, -beta, -alpha, null_move_depth, max_depth, &new_move, sp);
+		}
+		unmake_move(sp);
+
+		if (use_abdada)
+			abdada_finish(move_hash);
 
 		n_played++;
 
@@ -487,19 +878,68 @@ int search(int depth, int16_t alpha, const int16_t beta, const int null_move_dep
 			best_score = score;
 			*m         = move;
 
+			if (is_root_position)
+				sp.root_best_move_nodes = uint32_t(sp.cs.data.nodes + sp.cs.data.qnodes - nodes_before);
+
 			if (score > alpha) {
 				if (score >= beta) {
 					if (!sp.pos.is_capture_move(move))
 						beta_cutoff_move = move;
-					sp.cs.data.n_lmr_hit += is_lmr;
-					break;
+					sp.cs.count(sp.cs.data.n_lmr_hit, is_lmr);
+					return true;
 				}
 
 				alpha = score;
 			}
 		}
+
+		return false;
+	};
+
+	std::vector<libchess::Move> deferred_moves;
+	bool cutoff = false;
+	for(auto move : move_list) {
+		if (is_legal(sp, move) == false || move == excluded_move)
+			continue;
+
+		// quiet move pruning, never before a move was searched or while getting mated
+		if (!is_pv && !in_check && n_played > 0 && best_score > -9800 && !sp.pos.is_capture_move(move) && !sp.pos.is_promotion_move(move)) {
+			const pruning_parameters_t & pp = pruning_parameters;
+
+			if (pp.futility_enabled && depth <= pp.futility_max_depth && staticeval + pp.futility_margin[depth] <= alpha) {
+				sp.cs.count(sp.cs.data.n_futility);
+				continue;
+			}
+
+			if (pp.lmp_enabled && depth <= pp.lmp_max_depth && n_played >= pp.lmp_move_count[improving][depth]) {
+				sp.cs.count(sp.cs.data.n_lmp);
+				continue;
+			}
+
+			if (pp.history_pruning_enabled && depth <= pp.history_max_depth) {
+				auto piece_type_from = sp.pos.piece_type_on(move.from_square());
+				int  index           = history_index(sp.pos.side_to_move(), piece_type_from.value(), move.to_square());
+				if (sp.history[index] < -pp.history_margin * depth) {
+					sp.cs.count(sp.cs.data.n_history_pruned);
+					continue;
+				}
+			}
+		}
+
+		if (use_abdada && n_played > 0 && abdada_is_searching(abdada_move_hash(hash, move))) {
+			sp.cs.count(sp.cs.data.n_abdada_deferred);
+			deferred_moves.push_back(move);
+			continue;
+		}
+
+		cutoff = play_move(move);
+		if (cutoff)
+			break;
 	}
 
+	for(size_t i=0; i<deferred_moves.size() && !cutoff; i++)
+		cutoff = play_move(deferred_moves[i]);
+
 	// https://www.chessprogramming.org/History_Heuristic#History_Bonuses
 	if (beta_cutoff_move.has_value()) {
 		int bonus = depth * depth;
@@ -515,19 +955,22 @@ int search(int depth, int16_t alpha, const int16_t beta, const int null_move_dep
 			update_history(sp, index, -bonus);
 		}
 
-		sp.cs.data.n_moves_cutoff += n_played;
-		sp.cs.data.nmc_nodes++;
+		sp.cs.count(sp.cs.data.n_moves_cutoff, n_played);
+		sp.cs.count(sp.cs.data.nmc_nodes);
 	}
 
 	if (n_played == 0) {
-		if (in_check)
+		if (is_excluded)  // the excluded move was the only one: fail low, not (stale)mate
+			best_score = alpha;
+		else if (in_check)
 			best_score = -10000 + csd;
 		else
 			best_score = 0;
 	}
 
-	if (sp.stop->flag == false) {
-		sp.cs.data.tt_store++;
+	// a search with an excluded move did not look at the whole position
+	if (sp.stop->flag == false && !is_excluded) {
+		sp.cs.count(sp.cs.data.tt_store);
 
 		tt_entry_flag flag = EXACT;
 		if (best_score <= start_alpha)
@@ -537,6 +980,7 @@ int search(int depth, int16_t alpha, const int16_t beta, const int null_move_dep
 
 		int work_score = eval_to_tt(best_score, csd);
 
+		PHASE_TIMER(sp.cs, PHASE_TT);
 		if (best_score > start_alpha && m->value())
 			tti.store(hash, flag, depth, work_score, *m);
 		else if (tt_move.has_value())
@@ -545,9 +989,136 @@ int search(int depth, int16_t alpha, const int16_t beta, const int null_move_dep
 			tti.store(hash, flag, depth, work_score);
 	}
 
+	if (record && sp.stop->flag == false)
+		record_node(sp, depth, start_alpha, beta, best_score, *m, DEC_SEARCHED, cutoff ? n_played - 1 : -1, te.has_value());
+
 	return best_score;
 }
 
+// "go ponder" searches without a time limit; ponderhit() turns it into a timed
+// search (counting from the ponderhit) while keeping the iterations done so far
+static struct {
+	std::atomic_bool      hit        { false };
+	std::atomic_int       think_time { 0     };
+	std::atomic_bool      is_abs     { false };
+	std::atomic<uint64_t> ts         { 0     };
+} ponder_state;
+
+#if defined(linux) || defined(_WIN32) || defined(__ANDROID__) || defined(__APPLE__)
+// one long-lived timer thread instead of a new thread for every move
+class search_timer_t
+{
+private:
+	std::mutex              lock;
+	std::condition_variable cv;
+	std::optional<std::chrono::time_point<std::chrono::steady_clock> > deadline;
+	end_t                  *target { nullptr };
+	bool                    quit   { false   };
+	std::thread            *th     { nullptr };
+
+	void run()
+	{
+		set_thread_name("searchtotimer");
+
+		std::unique_lock<std::mutex> lck(lock);
+		while(!quit) {
+			if (deadline.has_value() == false) {
+				cv.wait(lck);
+				continue;
+			}
+
+			if (cv.wait_until(lck, deadline.value()) == std::cv_status::timeout && deadline.has_value() && std::chrono::steady_clock::now() >= deadline.value()) {
+				deadline.reset();
+				set_flag(target);
+				record_stop_request();
+#if !defined(__ANDROID__)
+				my_trace("# time is up; set stop flag\n");
+#endif
+			}
+		}
+	}
+
+public:
+	~search_timer_t()
+	{
+		if (th) {
+			{
+				std::unique_lock<std::mutex> lck(lock);
+				quit = true;
+				cv.notify_all();
+			}
+
+			th->join();
+			delete th;
+		}
+	}
+
+	// think_time <= 0: no deadline (yet), see set_deadline()
+	void arm(const int think_time, end_t *const stop)
+	{
+		std::unique_lock<std::mutex> lck(lock);
+
+		if (th == nullptr)
+			th = new std::thread(&search_timer_t::run, this);
+
+		if (think_time > 0)
+			deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(think_time);
+		else if (ponder_state.hit && ponder_state.think_time > 0) {
+			// the ponderhit came before this search armed the timer: set_deadline() ignored it
+			int64_t left_us = ponder_state.think_time * 1000ll - int64_t(esp_timer_get_time() - ponder_state.ts);
+			deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(std::max(int64_t(0), left_us));
+		}
+		else
+			deadline.reset();
+		target   = stop;
+		cv.notify_all();
+	}
+
+	// only while armed: a search that already finished must not be stopped afterwards;
+	// a search that did not arm yet picks the ponderhit up in arm()
+	void set_deadline(const int think_time)
+	{
+		std::unique_lock<std::mutex> lck(lock);
+
+		if (target == nullptr || think_time <= 0)
+			return;
+
+		deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(think_time);
+		cv.notify_all();
+	}
+
+	// after this returns, the stop flag will not be set by the timer
+	void disarm()
+	{
+		std::unique_lock<std::mutex> lck(lock);
+		deadline.reset();
+		target = nullptr;
+	}
+};
+
+static search_timer_t search_timer;
+#endif
+
+void reset_ponderhit()
+{
+	ponder_state.hit = false;
+}
+
+void ponderhit(const int think_time, const bool is_absolute_time)
+{
+	ponder_state.think_time = think_time;
+	ponder_state.is_abs     = is_absolute_time;
+	ponder_state.ts         = esp_timer_get_time();
+	ponder_state.hit        = true;
+
+#if defined(linux) || defined(_WIN32) || defined(__ANDROID__) || defined(__APPLE__)
+	search_timer.set_deadline(think_time);
+#else
+	if (think_time > 0)
+		esp_timer_start_once(think_timeout_timer, think_time * 1000ll);
+#endif
+}
+
 void timer(const int think_time, end_t *const ei)
 {
 	if (think_time > 0) {
@@ -576,36 +1147,311 @@ double calculate_EBF(const std::vector<uint64_t> & node_counts)
 void emit_statistics(const chess_stats & counts, const std::string & header)
 {
 	my_trace("# * %s *\n", header.c_str());
-	my_trace("# %u search %u qs: qs/s=%.3f, draws: %.2f%%, standing pat: %.2f%%\n", counts.data.nodes, counts.data.qnodes, double(counts.data.qnodes)/counts.data.nodes, counts.data.n_draws * 100. / counts.data.nodes, counts.data.n_standing_pat * 100. / counts.data.qnodes);
-	my_trace("# %.2f%% tt hit, %.2f tt query/store, %.2f%% syzygy hit\n", counts.data.tt_hit * 100. / counts.data.tt_query, counts.data.tt_query / double(counts.data.tt_store), counts.data.syzygy_query_hits * 100. / counts.data.syzygy_queries);
-	my_trace("# avg bco index: %.2f, qs bco index: %.2f, qsearlystop: %.2f%%\n", counts.data.n_moves_cutoff / double(counts.data.nmc_nodes), counts.data.n_qmoves_cutoff / double(counts.data.nmc_qnodes), counts.data.n_qs_early_stop * 100. / counts.data.qnodes);
-	my_trace("# null move co: %.2f%%, LMR co: %.2f%%, static eval co: %.2f%%\n", counts.data.n_null_move_hit * 100. / counts.data.n_null_move, counts.data.n_lmr_hit * 100.0 / counts.data.n_lmr, counts.data.n_static_eval_hit * 100. / counts.data.n_static_eval);
-	my_trace("# avg a/b distance: %.2f/%.2f\n", counts.data.alpha_distance / double(counts.data.n_alpha_distances), counts.data.beta_distance / double(counts.data.n_beta_distances));
+	if constexpr (chess_stats::full) {
+		my_trace("# %u search %u qs: qs/s=%.3f, draws: %.2f%%, standing pat: %.2f%%\n", counts.data.nodes, counts.data.qnodes, double(counts.data.qnodes)/counts.data.nodes, counts.data.n_draws * 100. / counts.data.nodes, counts.data.n_standing_pat * 100. / counts.data.qnodes);
+		my_trace("# %.2f%% tt hit, %.2f tt query/store, %.2f%% syzygy hit\n", counts.data.tt_hit * 100. / counts.data.tt_query, counts.data.tt_query / double(counts.data.tt_store), counts.data.syzygy_query_hits * 100. / counts.data.syzygy_queries);
+		my_trace("# avg bco index: %.2f, qs bco index: %.2f, qs pruned: %.2f/qnode\n", counts.data.n_moves_cutoff / double(counts.data.nmc_nodes), counts.data.n_qmoves_cutoff / double(counts.data.nmc_qnodes), counts.data.n_qs_early_stop / double(counts.data.qnodes));
+		my_trace("# null move co: %.2f%%, LMR co: %.2f%%, static eval co: %.2f%%\n", counts.data.n_null_move_hit * 100. / counts.data.n_null_move, counts.data.n_lmr_hit * 100.0 / counts.data.n_lmr, counts.data.n_static_eval_hit * 100. / counts.data.n_static_eval);
+		my_trace("# futility: %u (%.2f/node), LMP: %u (%.2f/node), history pruning: %u (%.2f/node)\n", counts.data.n_futility, counts.data.n_futility / double(counts.data.nodes), counts.data.n_lmp, counts.data.n_lmp / double(counts.data.nodes), counts.data.n_history_pruned, counts.data.n_history_pruned / double(counts.data.nodes));
+		my_trace("# singular: %u, extended: %.2f%%, multi-cut: %.2f%%\n", counts.data.n_singular, counts.data.n_singular_ext * 100. / counts.data.n_singular, counts.data.n_multi_cut * 100. / counts.data.n_singular);
+		my_trace("# ABDADA deferred moves: %u\n", counts.data.n_abdada_deferred);
+		my_trace("# avg a/b distance: %.2f/%.2f\n", counts.data.alpha_distance / double(counts.data.n_alpha_distances), counts.data.beta_distance / double(counts.data.n_beta_distances));
+	}
+	else {
+		my_trace("# %u search %u qs (minimal statistics build)\n", counts.data.nodes, counts.data.qnodes);
+	}
+#if defined(WITH_PHASE_TIMERS)
+	// summed over the threads; "search" is the wall time of the iterations
+	const char *const phase_names[] = { "eval", "movegen", "sort", "tt", "legality", "search" };
+	uint64_t total = counts.data.phase_ticks[PHASE_SEARCH];
+	my_trace("# phase         ticks      %%\n");
+	for(int i=0; i<PHASE_N; i++)
+		my_trace("# %-8s %12" PRIu64 " %6.2f\n", phase_names[i], counts.data.phase_ticks[i], counts.data.phase_ticks[i] * 100. / total);
+#endif
+}
+
+// root move splitting: thread 0 searches the first root move, then publishes the
+// others as a job of which all threads (including thread 0) claim moves
+typedef struct
+{
+	std::mutex                  lock;
+	std::condition_variable     cv;
+	uint64_t                    id         { 0     };
+	bool                        active     { false };
+	int                         depth      { 0     };
+	int16_t                     alpha      { 0     };
+	int16_t                     beta       { 0     };
+	std::vector<libchess::Move> moves;
+	size_t                      next       { 0     };
+	int                         busy       { 0     };
+	int                         best_score { 0     };
+	libchess::Move              best_move;
+} root_split_job_t;
+
+static root_split_job_t root_job;
+
+static int root_split_search_move(search_pars_t *const sp, const libchess::Move move, const int depth, const int16_t alpha, const int16_t beta, const bool full_window)
+{
+	libchess::Move ignore { };
+	int            score  = 0;
+
+	make_move(*sp, move);
+	if (full_window)
+		score = -search(depth - 1, -beta, -alpha, 0, depth, &ignore, *sp);
+	else {
+		score = -search(depth - 1, -alpha - 1, -alpha, 0, depth, &ignore, *sp);
+		if (score > alpha && score < beta)
+			score = -search(depth - 1, -beta, -alpha, 0, depth, &ignore, *sp);
+	}
+	unmake_move(*sp);
+
+	return score;
+}
+
+// claims and searches moves of the current job until none are left
+static void root_split_work(search_pars_t *const sp, std::unique_lock<std::mutex> & lck)
+{
+	while(root_job.active && root_job.next < root_job.moves.size() && !sp->stop->flag) {
+		uint64_t       id    = root_job.id;
+		libchess::Move move  = root_job.moves.at(root_job.next++);
+		int            depth = root_job.depth;
+		int16_t        alpha = root_job.alpha;
+		int16_t        beta  = root_job.beta;
+		root_job.busy++;
+
+		lck.unlock();
+		int score = root_split_search_move(sp, move, depth, alpha, beta, false);
+		lck.lock();
+
+		root_job.busy--;
+
+		if (id == root_job.id && !sp->stop->flag && score > root_job.best_score) {
+			root_job.best_score = score;
+			root_job.best_move  = move;
+
+			if (score > root_job.alpha)
+				root_job.alpha = score;
+
+			if (score >= root_job.beta)  // no need to hand out the rest
+				root_job.next = root_job.moves.size();
+		}
+
+		root_job.cv.notify_all();
+	}
+}
+
+static void root_split_helper(search_pars_t *const sp)
+{
+	std::unique_lock<std::mutex> lck(root_job.lock);
+
+	while(!sp->stop->flag) {
+		root_job.cv.wait(lck, [sp] { return sp->stop->flag || (root_job.active && root_job.next < root_job.moves.size()); });
+
+		root_split_work(sp, lck);
+	}
+}
+
+void root_split_wakeup()
+{
+	std::unique_lock<std::mutex> lck(root_job.lock);
+	root_job.cv.notify_all();
+}
+
+// deterministic mode: the threads take turns, each searching about 1024 nodes at a time,
+// so that the order of the TT writes does not depend on the scheduler
+bool deterministic = false;
+
+static struct {
+	std::mutex              lock;
+	std::condition_variable cv;
+	int                     n_threads { 1     };
+	int                     turn      { 0     };
+	std::vector<bool>       done;
+	bool                    closed    { false };  // thread 0 left the search
+} lockstep;
+
+void lockstep_start(const int n_threads)
+{
+	std::unique_lock<std::mutex> lck(lockstep.lock);
+	lockstep.n_threads = n_threads;
+	lockstep.turn      = 0;
+	lockstep.closed    = false;
+	lockstep.done.assign(n_threads, false);
+}
+
+static void lockstep_pass_turn(const int thread_nr)
+{
+	for(int i=1; i<=lockstep.n_threads; i++) {
+		int next = (thread_nr + i) % lockstep.n_threads;
+		if (lockstep.done[next] == false) {
+			lockstep.turn = next;
+			break;
+		}
+	}
+
+	lockstep.cv.notify_all();
+}
+
+// after thread 0 finished, the others stop at the point where they were waiting
+static void lockstep_wait_turn(search_pars_t & sp, std::unique_lock<std::mutex> & lck)
+{
+	lockstep.cv.wait(lck, [&sp] { return lockstep.turn == sp.thread_nr || lockstep.closed; });
+
+	if (lockstep.closed)
+		set_flag(sp.stop);
+}
+
+static void lockstep_enter(search_pars_t & sp)
+{
+	if (lockstep.n_threads < 2)
+		return;
+
+	std::unique_lock<std::mutex> lck(lockstep.lock);
+	lockstep_wait_turn(sp, lck);
+}
+
+void lockstep_yield(search_pars_t & sp)
+{
+	if (lockstep.n_threads < 2)
+		return;
+
+	std::unique_lock<std::mutex> lck(lockstep.lock);
+	lockstep_pass_turn(sp.thread_nr);
+	lockstep_wait_turn(sp, lck);
+}
+
+static void lockstep_leave(search_pars_t & sp)
+{
+	if (lockstep.n_threads < 2)
+		return;
+
+	std::unique_lock<std::mutex> lck(lockstep.lock);
+	lockstep.done[sp.thread_nr] = true;
+	if (sp.thread_nr == 0)
+		lockstep.closed = true;
+	lockstep_pass_turn(sp.thread_nr);
+}
+
+// replaces search() at the root for thread 0; aspiration is still done by search_it
+static int root_split_search(const int depth, int16_t alpha, const int16_t beta, libchess::Move *const m, search_pars_t *const sp)
+{
+	const int start_alpha = alpha;
+
+	auto move_list = sp->pos.legal_move_list();
+
+	sort_movelist_compare smc(*sp);
+	std::optional<tt_entry> te = tt_lookup(*sp, sp->pos.hash());
+	if (te.has_value() && te.value().m)
+		smc.add_first_move(libchess::Move(te.value().m));
+	if (m->value())
+		smc.add_first_move(*m);
+	sort_movelist(move_list, smc);
+
+	std::vector<libchess::Move> moves(move_list.begin(), move_list.end());
+
+	// the first move gives the bound for the others
+	libchess::Move best_move  = moves.at(0);
+	int            best_score = root_split_search_move(sp, best_move, depth, alpha, beta, true);
+	if (sp->stop->flag)
+		return 0;
+
+	if (best_score > alpha)
+		alpha = best_score;
+
+	if (best_score < beta && moves.size() > 1) {
+		std::unique_lock<std::mutex> lck(root_job.lock);
+
+		root_job.id++;
+		root_job.active     = true;
+		root_job.depth      = depth;
+		root_job.alpha      = alpha;
+		root_job.beta       = beta;
+		root_job.moves.assign(moves.begin() + 1, moves.end());
+		root_job.next       = 0;
+		root_job.busy       = 0;
+		root_job.best_score = best_score;
+		root_job.best_move  = best_move;
+		root_job.cv.notify_all();
+
+		root_split_work(sp, lck);
+
+		// the timer only sets the stop flag of thread 0, so poll it
+		while(!sp->stop->flag && root_job.busy > 0)
+			root_job.cv.wait_for(lck, std::chrono::milliseconds(5));
+
+		root_job.active = false;
+
+		if (sp->stop->flag)
+			return 0;
+
+		best_score = root_job.best_score;
+		best_move  = root_job.best_move;
+	}
+
+	*m = best_move;
+
+	tt_entry_flag flag = EXACT;
+	if (best_score <= start_alpha)
+		flag = UPPERBOUND;
+	else if (best_score >= beta)
+		flag = LOWERBOUND;
+	PHASE_TIMER(sp->cs, PHASE_TT);
+	tti.store(sp->pos.hash(), flag, depth, eval_to_tt(best_score, 0), best_move);
+
+	return best_score;
+}
+
+// lazy SMP: helper threads skip depths so that they spread over the iterations
+constexpr int n_skip_entries = 20;
+constexpr int skip_size [n_skip_entries] = { 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4 };
+constexpr int skip_phase[n_skip_entries] = { 0, 1, 0, 1, 2, 3, 0, 1, 2, 3, 4, 5, 0, 1, 2, 3, 4, 5, 6, 7 };
+
+static bool skip_depth(const int thread_nr, const int depth)
+{
+	if (thread_nr == 0 || smp_mode != SMP_LAZY)
+		return false;
+
+	int index = (thread_nr - 1) % n_skip_entries;
+
+	return ((depth + skip_phase[index]) / skip_size[index]) % 2;
 }
 
 std::pair<libchess::Move, int> search_it(const int search_time, const bool is_absolute_time, search_pars_t *const sp, const int ultimate_max_depth, std::optional<uint64_t> max_n_nodes, const bool output)
 {
 	uint64_t t_offset = esp_timer_get_time();
 
-#if defined(linux) || defined(_WIN32) || defined(__ANDROID__) || defined(__APPLE__)
-	std::thread *think_timeout_timer { nullptr };
-#endif
+	time_manager tm(search_time, is_absolute_time, t_offset);
+	bool         ponder_converted = false;
 
 	if (sp->thread_nr == 0) {
-		if (search_time > 0) {
 #if defined(linux) || defined(_WIN32) || defined(__ANDROID__) || defined(__APPLE__)
-			think_timeout_timer = new std::thread([search_time, sp] {
-					set_thread_name("searchtotimer");
-					timer(search_time, sp->stop);
-				});
+		search_timer.arm(search_time, sp->stop);
 #else
+		if (search_time > 0)
 			esp_timer_start_once(think_timeout_timer, search_time * 1000ll);
 #endif
-		}
 	}
 
 	int16_t best_score = 0;
 
+	sp->ply = 0;
+	sp->stack[0].material_key  = calculate_material_key(sp->pos);
+	sp->stack[0].excluded_move = libchess::Move(0);
+
+	sp->result_depth = 0;
+
+	if (sp->thread_nr == 0)
+		record_first_node();
+
+	if (smp_mode == SMP_ROOTSPLIT && sp->thread_nr > 0) {
+		root_split_helper(sp);
+		publish_statistics(*sp);
+		tree_recorder_flush();
+		return { libchess::Move(0), 0 };
+	}
+
+	lockstep_enter(*sp);
+
 	auto move_list = sp->pos.legal_move_list();
 	libchess::Move best_move { *move_list.begin() };
 
@@ -627,23 +1473,45 @@ std::pair<libchess::Move, int> search_it(const int search_time, const bool is_ab
 		uint64_t previous_node_count = 0;
 
 		while(ultimate_max_depth == -1 || max_depth <= ultimate_max_depth) {
+			if (max_depth < 127 && skip_depth(sp->thread_nr, max_depth)) {
+				sp->best_moves[max_depth] = best_move;
+				max_depth++;
+				continue;
+			}
 #if defined(ESP32)
 			sp->md = 0;
 #endif
 			if (max_depth >= 4)
 				cur_move = sp->best_moves[max_depth - 3];
-			int score = search(max_depth, alpha, beta, 0, max_depth, &cur_move, *sp);
+			int      score            = 0;
+			uint64_t iteration_start  = esp_timer_get_time();
+			uint32_t own_nodes_before = sp->cs.data.nodes + sp->cs.data.qnodes;
+			sp->root_best_move_nodes  = 0;
+			{
+				PHASE_TIMER(sp->cs, PHASE_SEARCH);
+				if (smp_mode == SMP_ROOTSPLIT)
+					score = root_split_search(max_depth, alpha, beta, &cur_move, sp);
+				else
+					score = search(max_depth, alpha, beta, 0, max_depth, &cur_move, *sp);
+			}
+			uint64_t iteration_us     = esp_timer_get_time() - iteration_start;
+			uint32_t own_nodes        = sp->cs.data.nodes + sp->cs.data.qnodes - own_nodes_before;
 
 			if (sp->stop->flag) {
 				if (sp->thread_nr == 0 && output) {
 #if !defined(__ANDROID__)
 					my_trace("info string stop flag set\n");
 #endif
-					printf("info depth %d score cp %d hashfull %d\n", max_depth - 1, best_score, tti.get_per_mille_filled());
+					uci_info_t info;
+					info.depth       = max_depth - 1;
+					info.score       = best_score;
+					info.interrupted = true;
+					output_info(std::move(info));
 				}
 				break;
 			}
 
+			publish_statistics(*sp);
 			auto     counts      = simple_search_statistics();
 			uint64_t cur_n_nodes = counts.first;
 			node_counts.push_back(cur_n_nodes - previous_node_count);
@@ -677,12 +1545,12 @@ std::pair<libchess::Move, int> search_it(const int search_time, const bool is_ab
 			}
 			else {
 				if (alpha != -32767) {
-					sp->cs.data.alpha_distance += abs(score - alpha);
-					sp->cs.data.n_alpha_distances++;
+					sp->cs.count(sp->cs.data.alpha_distance, abs(score - alpha));
+					sp->cs.count(sp->cs.data.n_alpha_distances);
 				}
 				if (beta != 32767) {
-					sp->cs.data.beta_distance  += abs(beta - score);
-					sp->cs.data.n_beta_distances++;
+					sp->cs.count(sp->cs.data.beta_distance, abs(beta - score));
+					sp->cs.count(sp->cs.data.n_beta_distances);
 				}
 
 				alpha_repeat = beta_repeat = 0;
@@ -698,6 +1566,13 @@ std::pair<libchess::Move, int> search_it(const int search_time, const bool is_ab
 				best_move  = cur_move;
 				best_score = score;
 
+				sp->result_move  = best_move;
+				sp->result_score = score;
+				sp->result_depth = max_depth;
+
+				if (sp->thread_nr == 0)
+					record_iteration_end();
+
 #if defined(linux)
 				strncpy(sp->move, best_move.to_str().c_str(), 4);
 				sp->score = score;
@@ -705,40 +1580,30 @@ std::pair<libchess::Move, int> search_it(const int search_time, const bool is_ab
 
 				uint64_t   thought_ms = (esp_timer_get_time() - t_offset) / 1000;
 
-				if (sp->thread_nr == 0) {
-					std::vector<libchess::Move> pv = get_pv_from_tt(sp->pos, best_move);
-					std::string pv_str;
-					for(auto & move : pv)
-						pv_str += " " + move.to_str();
-
-					double      ebf     = calculate_EBF(node_counts);
-					std::string ebf_str = ebf >= 0 ? std::to_string(ebf) : "";
-					if (ebf_str.empty() == false)
-						ebf_str = "ebf " + ebf_str + " ";
-
-					uint64_t use_thought_ms = std::max(uint64_t(1), thought_ms);  // prevent div. by 0
-					if (output) {
-						if (abs(score) > 9800) {
-							int mate_moves = (10000 - abs(score) + 1) / 2 * (score < 0 ? -1 : 1);
-							printf("info depth %d score mate %d nodes %" PRIu64 " %stime %" PRIu64 " nps %" PRIu64 " tbhits %" PRIu64 " hashfull %d pv%s\n",
-									max_depth, mate_moves,
-									cur_n_nodes, ebf_str.c_str(), thought_ms, uint64_t(cur_n_nodes * 1000 / use_thought_ms),
-									counts.second, tti.get_per_mille_filled(), pv_str.c_str());
-						}
-						else {
-							printf("info depth %d score cp %d nodes %" PRIu64 " %stime %" PRIu64 " nps %" PRIu64 " tbhits %" PRIu64 " hashfull %d pv%s\n",
-									max_depth, score,
-									cur_n_nodes, ebf_str.c_str(), thought_ms, uint64_t(cur_n_nodes * 1000 / use_thought_ms),
-									counts.second, tti.get_per_mille_filled(), pv_str.c_str());
-						}
-					}
+				// the PV is taken now, the TT changes while the line waits for the writer
+				if (sp->thread_nr == 0 && output) {
+					uci_info_t info;
+					info.depth   = max_depth;
+					info.score   = score;
+					info.nodes   = cur_n_nodes;
+					info.tb_hits = counts.second;
+					info.time_ms = thought_ms;
+					info.ebf     = calculate_EBF(node_counts);
+					info.pv      = get_pv_from_tt(sp->pos, best_move);
+					output_info(std::move(info));
+				}
+
+				if (ponder_state.hit && ponder_converted == false) {
+					tm.restart(ponder_state.think_time, ponder_state.is_abs, ponder_state.ts);
+					ponder_converted = true;
 				}
 
-				if ((thought_ms > uint64_t(search_time / 2) && search_time > 0 && is_absolute_time == false) ||
-				    (thought_ms >= search_time && is_absolute_time == true)) {
+				double root_fraction = own_nodes ? std::min(1., sp->root_best_move_nodes / double(own_nodes)) : 0.;
+				uint64_t now = esp_timer_get_time();
+				if (tm.stop_after_iteration(now, best_move, score, root_fraction, iteration_us, calculate_EBF(node_counts))) {
 #if !defined(__ANDROID__)
 					if (output)
-						my_trace("info string time %u is up %" PRIu64 "\n", search_time, thought_ms);
+						my_trace("info string time %d is up %" PRIu64 " (soft limit %d)\n", search_time, tm.get_elapsed_ms(now), tm.get_soft_limit());
 #endif
 					break;
 				}
@@ -777,13 +1642,10 @@ std::pair<libchess::Move, int> search_it(const int search_time, const bool is_ab
 	}
 
 	if (sp->thread_nr == 0) {
+		record_stop_request();
 #if defined(linux) || defined(_WIN32) || defined(__ANDROID__) || defined(__APPLE__)
+		search_timer.disarm();
 		set_flag(sp->stop);
-
-		if (think_timeout_timer) {
-			think_timeout_timer->join();
-			delete think_timeout_timer;
-		}
 #else
 		esp_timer_stop(think_timeout_timer);
 
@@ -793,5 +1655,11 @@ std::pair<libchess::Move, int> search_it(const int search_time, const bool is_ab
 #endif
 	}
 
+	publish_statistics(*sp);
+
+	lockstep_leave(*sp);
+
+	tree_recorder_flush();
+
 	return { best_move, best_score };
 }
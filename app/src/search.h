@@ -1,3 +1,5 @@
+#pragma once
+
 #include <cstdint>
 #include <optional>
 #include <libchess/Position.h>
@@ -19,9 +21,46 @@ public:
 };
 
 void sort_movelist(libchess::MoveList & move_list, sort_movelist_compare & smc);
+int  see(const libchess::Position & pos, const libchess::Move move);
+
+constexpr int max_pruning_depth = 8;
+
+// quiet move pruning; each technique can be switched off for SPRT testing
+typedef struct
+{
+	bool futility_enabled;
+	int  futility_max_depth;
+	int  futility_margin[max_pruning_depth + 1];  // per depth
+
+	bool lmp_enabled;
+	int  lmp_max_depth;
+	int  lmp_move_count[2][max_pruning_depth + 1];  // [improving][depth]
+
+	bool history_pruning_enabled;
+	int  history_max_depth;
+	int  history_margin;  // per depth
+} pruning_parameters_t;
+
+extern pruning_parameters_t pruning_parameters;
+
+typedef enum { SMP_LAZY, SMP_ABDADA, SMP_ROOTSPLIT } smp_mode_t;
+
+extern smp_mode_t smp_mode;
+
+std::optional<smp_mode_t> smp_mode_from_string(const std::string & name);
+const char               *smp_mode_name(const smp_mode_t mode);
+void                      root_split_wakeup();
+
+extern bool deterministic;
+
+void lockstep_start(const int n_threads);
+void lockstep_yield(search_pars_t & sp);
 
 void init_lmr();
 bool is_insufficient_material_draw(const libchess::Position & pos);
 int qs(int alpha, int beta, int qsdepth, search_pars_t & sp);
 std::pair<libchess::Move, int> search_it(const int search_time, const bool is_absolute_time, search_pars_t *const sp, const int ultimate_max_depth, std::optional<uint64_t> max_n_nodes, const bool output);
+void timer(const int think_time, end_t *const ei);
+void reset_ponderhit();
+void ponderhit(const int think_time, const bool is_absolute_time);
 void emit_statistics(const chess_stats & count, const std::string & header);
@@ -3,21 +3,25 @@
 #include "stats.h"
 
 
-chess_stats::chess_stats()
+template <typename policy>
+chess_stats_t<policy>::chess_stats_t()
 {
 	reset();
 }
 
-chess_stats::~chess_stats()
+template <typename policy>
+chess_stats_t<policy>::~chess_stats_t()
 {
 }
 
-void chess_stats::reset()
+template <typename policy>
+void chess_stats_t<policy>::reset()
 {
 	memset(&data, 0x00, sizeof data);
 }
 
-void chess_stats::add(const chess_stats & source)
+template <typename policy>
+void chess_stats_t<policy>::add(const chess_stats_t & source)
 {
 	this->data.nodes           += source.data.nodes;
 	this->data.qnodes          += source.data.qnodes;
@@ -38,8 +42,29 @@ void chess_stats::add(const chess_stats & source)
 	this->data.n_static_eval     += source.data.n_static_eval;
 	this->data.n_static_eval_hit += source.data.n_static_eval_hit;
 
+	this->data.n_futility       += source.data.n_futility;
+	this->data.n_lmp            += source.data.n_lmp;
+	this->data.n_history_pruned += source.data.n_history_pruned;
+
+	this->data.n_singular     += source.data.n_singular;
+	this->data.n_singular_ext += source.data.n_singular_ext;
+	this->data.n_multi_cut    += source.data.n_multi_cut;
+
+	this->data.n_abdada_deferred += source.data.n_abdada_deferred;
+
 	this->data.n_moves_cutoff  += source.data.n_moves_cutoff;
 	this->data.nmc_nodes       += source.data.nmc_nodes;
 	this->data.n_qmoves_cutoff += source.data.n_qmoves_cutoff;
 	this->data.nmc_qnodes      += source.data.nmc_qnodes;
+
+	this->data.syzygy_queries    += source.data.syzygy_queries;
+	this->data.syzygy_query_hits += source.data.syzygy_query_hits;
+
+#if defined(WITH_PHASE_TIMERS)
+	for(int i=0; i<PHASE_N; i++)
+		this->data.phase_ticks[i] += source.data.phase_ticks[i];
+#endif
 }
+
+template class chess_stats_t<stats_policy_full>;
+template class chess_stats_t<stats_policy_minimal>;
@@ -1,8 +1,20 @@
+#pragma once
+
 #include <cstdint>
 
-class chess_stats
+#include "phase_timer.h"
+
+// full: all counters, for analysis; minimal: only what UCI, bench --json and the
+// metrics report (nodes, tt and syzygy queries/hits), the others are compiled out
+struct stats_policy_full    { static constexpr bool full = true;  };
+struct stats_policy_minimal { static constexpr bool full = false; };
+
+template <typename policy>
+class chess_stats_t
 {
 public:
+	static constexpr bool full = policy::full;
+
 	struct {
 		uint32_t  nodes;
 		uint32_t  qnodes;
@@ -29,6 +41,16 @@ public:
 		uint32_t  n_static_eval;
 		uint32_t  n_static_eval_hit;
 
+		uint32_t  n_futility;
+		uint32_t  n_lmp;
+		uint32_t  n_history_pruned;
+
+		uint32_t  n_singular;
+		uint32_t  n_singular_ext;
+		uint32_t  n_multi_cut;
+
+		uint32_t  n_abdada_deferred;
+
 		uint64_t  n_moves_cutoff;
 		uint64_t  nmc_nodes;
 		uint64_t  n_qmoves_cutoff;
@@ -36,11 +58,27 @@ public:
 
 		uint64_t  syzygy_queries;
 		uint64_t  syzygy_query_hits;
+
+#if defined(WITH_PHASE_TIMERS)
+		uint64_t  phase_ticks[PHASE_N];
+#endif
 	} data;
 
-	chess_stats();
-	virtual ~chess_stats();
+	chess_stats_t();
+	virtual ~chess_stats_t();
 
 	void reset();
-	void add(const chess_stats & in);
+	void add(const chess_stats_t & in);
+
+	template <typename T, typename V = T>
+	void count(T & counter, const V value = 1) {
+		if constexpr (full)
+			counter += value;
+	}
 };
+
+#if defined(STATS_MINIMAL)
+typedef chess_stats_t<stats_policy_minimal> chess_stats;
+#else
+typedef chess_stats_t<stats_policy_full> chess_stats;
+#endif
@@ -2,6 +2,7 @@
 
 #include <libchess/Position.h>
 
+#include "dfpn.h"
 #include "eval.h"
 #include "main.h"
 #include "san.h"
@@ -498,12 +499,15 @@ std::vector<std::pair<libchess::Position, const std::string> > load_epd(const st
 void test_mate_finder(const std::string & filename, const int search_time)
 {
 	init_lmr();
+	init_material_table();
 
 	int         mates_found = 0;
 	auto        positions   = load_epd(filename);
 	size_t      n           = positions.size();
 	printf("Loaded %zu tests\n", n);
 
+	uint64_t start_ts = esp_timer_get_time();
+
 	for(size_t i=0; i<n; i++) {
 		clear_flag(sp.at(0)->stop);
 		sp.at(0)->pos = positions.at(i).first;
@@ -513,6 +517,41 @@ void test_mate_finder(const std::string & filename, const int search_time)
 		mates_found += hit;
 	}
 
-	printf("%d %.2f %zu\n", mates_found, mates_found * 100. / n, n);
+	double took = std::max(uint64_t(1), esp_timer_get_time() - start_ts) / 1000000.;
+
+	printf("%d %.2f %zu %.3f mates/s\n", mates_found, mates_found * 100. / n, n, mates_found / took);
+}
+
+void test_pn_mate_finder(const std::string & filename, const int search_time)
+{
+	end_t stop;
+	dfpn  solver(&stop, 64 * 1024 * 1024);
+
+	int         mates_found = 0;
+	uint64_t    nodes       = 0;
+	auto        positions   = load_epd(filename);
+	size_t      n           = positions.size();
+	printf("Loaded %zu tests\n", n);
+
+	uint64_t start_ts = esp_timer_get_time();
+
+	for(size_t i=0; i<n; i++) {
+		clear_flag(&stop);
+		solver.reset();
+
+		std::thread *timer_thread = new std::thread([search_time, &stop] { timer(search_time, &stop); });
+
+		auto rc = solver.solve(positions.at(i).first, dfpn_max_mate_moves);
+		mates_found += rc.has_value();
+		nodes       += solver.get_node_count();
+
+		set_flag(&stop);
+		timer_thread->join();
+		delete timer_thread;
+	}
+
+	double took = std::max(uint64_t(1), esp_timer_get_time() - start_ts) / 1000000.;
+
+	printf("%d %.2f %zu %.3f mates/s %.0f nps\n", mates_found, mates_found * 100. / n, n, mates_found / took, nodes / took);
 }
 #endif
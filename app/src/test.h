@@ -1,2 +1,3 @@
 void run_tests();
 void test_mate_finder(const std::string & filename, const int search_time);
+void test_pn_mate_finder(const std::string & filename, const int search_time);
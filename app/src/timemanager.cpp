@@ -0,0 +1,126 @@
+#include <algorithm>
+#include <cstdio>
+#include <libchess/Position.h>
+
+#include "timemanager.h"
+
+
+// an iteration normally stops after this part of the think time
+constexpr double soft_fraction = 0.5;
+constexpr double min_scale     = 0.4;
+constexpr double max_scale     = 2.0;
+
+int move_overhead = 10;
+
+int allocate_think_time(const int ms, const int inc, const int moves_to_go)
+{
+	int cur_n_moves = moves_to_go <= 0 ? 40 : moves_to_go;
+
+	int think_time = (ms + (cur_n_moves - 1) * inc) / double(cur_n_moves + 7);
+
+	int limit_duration_min = ms / 15;
+	if (think_time > limit_duration_min)
+		think_time = limit_duration_min;
+
+	return std::max(1, think_time - move_overhead);
+}
+
+int allocate_move_time(const int movetime)
+{
+	return std::max(1, movetime - move_overhead);
+}
+
+// like app/time-test.py: the worst case is a search that uses all of its think
+// time, the expected case one that stops at the soft limit
+void simulate_time_control(const int ms, const int inc, const int moves_to_go, const int n_moves)
+{
+	int ms_worst    = ms;
+	int ms_expected = ms;
+	int min_worst   = ms;
+
+	printf("# move overhead: %d ms\n", move_overhead);
+	printf("# move think_ms soft_ms clock_worst clock_expected\n");
+
+	for(int move=1; move<=n_moves; move++) {
+		int cur_moves_to_go = moves_to_go > 0 ? moves_to_go - (move - 1) % moves_to_go : 40 - move;
+
+		int think_time = allocate_think_time(ms_worst, inc, cur_moves_to_go);
+		int soft       = think_time * soft_fraction;
+
+		ms_worst    += inc - think_time - move_overhead;
+		ms_expected += inc - allocate_think_time(ms_expected, inc, cur_moves_to_go) * soft_fraction - move_overhead;
+		min_worst    = std::min(min_worst, ms_worst);
+
+		printf("%d %d %d %d %d\n", move, think_time, soft, ms_worst, ms_expected);
+
+		if (moves_to_go > 0 && move % moves_to_go == 0) {
+			ms_worst    += ms;
+			ms_expected += ms;
+		}
+	}
+
+	printf("# lowest clock (worst case): %d ms%s\n", min_worst, min_worst <= 0 ? ", FLAGGED" : "");
+}
+
+time_manager::time_manager(const int think_time, const bool is_absolute, const uint64_t start_ts) :
+	think_time(think_time),
+	is_absolute(is_absolute),
+	start_ts(start_ts)
+{
+}
+
+void time_manager::restart(const int think_time, const bool is_absolute, const uint64_t start_ts)
+{
+	this->think_time  = think_time;
+	this->is_absolute = is_absolute;
+	this->start_ts    = start_ts;
+}
+
+uint64_t time_manager::get_elapsed_ms(const uint64_t now) const
+{
+	return (now - start_ts) / 1000;
+}
+
+int time_manager::get_soft_limit() const
+{
+	if (think_time <= 0)
+		return -1;
+	if (is_absolute)
+		return think_time;
+
+	return std::min(double(think_time), think_time * soft_fraction * scale);
+}
+
+bool time_manager::stop_after_iteration(const uint64_t now, const libchess::Move & move, const int score, const double root_fraction, const uint64_t iteration_us, const double ebf)
+{
+	// an unstable best move or a dropping score asks for more time, a best
+	// move that takes (almost) all nodes for less
+	best_move_changes /= 2;
+	if (n_iterations > 0 && move != best_move)
+		best_move_changes += 1;
+
+	double score_factor = 1.;
+	if (n_iterations > 0 && score < best_score)
+		score_factor += std::min(best_score - score, 100) / 200.;
+
+	double node_factor = root_fraction > 0.5 ? 1.5 - root_fraction : 1.;
+
+	scale = std::clamp((1. + best_move_changes * 0.5) * score_factor * node_factor, min_scale, max_scale);
+
+	best_move  = move;
+	best_score = score;
+	n_iterations++;
+
+	if (think_time <= 0)
+		return false;
+
+	uint64_t elapsed_ms = get_elapsed_ms(now);
+	if (elapsed_ms >= uint64_t(get_soft_limit()))
+		return true;
+
+	// the result of an iteration that is cut off by the timer is not used
+	if (ebf > 0 && elapsed_ms + iteration_us * ebf / 1000 >= uint64_t(think_time))
+		return true;
+
+	return false;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <libchess/Position.h>
+
+
+// ms lost per move between our bestmove and the clock being stopped (GUI, network)
+extern int move_overhead;
+
+// hard limit (ms) for one move; moves_to_go <= 0: unknown
+int allocate_think_time(const int ms, const int inc, const int moves_to_go);
+int allocate_move_time(const int movetime);
+
+// replays allocate_think_time() for a whole game, see the "timesim" command
+void simulate_time_control(const int ms, const int inc, const int moves_to_go, const int n_moves);
+
+// decides after each completed iteration whether a next one is started; the
+// timer enforces think_time as the hard limit
+class time_manager
+{
+private:
+	int      think_time  { -1    };
+	bool     is_absolute { false };
+	uint64_t start_ts    { 0     };  // us
+
+	libchess::Move best_move         { 0  };
+	int            best_score        { 0  };
+	int            n_iterations      { 0  };
+	double         best_move_changes { 0. };
+	double         scale             { 1. };
+
+public:
+	time_manager(const int think_time, const bool is_absolute, const uint64_t start_ts);
+
+	// e.g. at a ponderhit: the clock starts again, the history is kept
+	void restart(const int think_time, const bool is_absolute, const uint64_t start_ts);
+
+	uint64_t get_elapsed_ms(const uint64_t now) const;
+	int      get_soft_limit() const;
+
+	// root_fraction: part of the nodes of the iteration that went into the best move (0 if unknown), ebf < 0 if unknown
+	bool     stop_after_iteration(const uint64_t now, const libchess::Move & move, const int score, const double root_fraction, const uint64_t iteration_us, const double ebf);
+};
@@ -0,0 +1,168 @@
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cinttypes>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <mutex>
+#include <thread>
+#include <unistd.h>
+
+#include "main.h"
+#include "tracelog.h"
+
+
+constexpr size_t trace_ring_size = 512;  // power of 2
+constexpr size_t trace_line_size = 496;
+
+// bounded multi-producer queue (D. Vyukov): a producer claims a position with a
+// CAS on enqueue_pos and publishes the slot via its sequence number
+typedef struct {
+	std::atomic<uint64_t> sequence;  // minus the slot index, so that all-zero is the initial state
+	uint64_t              ts;
+	char                  text[trace_line_size];
+} trace_slot_t;
+
+static trace_slot_t          ring[trace_ring_size];
+static std::atomic<uint64_t> enqueue_pos { 0 };
+static uint64_t              dequeue_pos { 0 };  // writer thread only
+static std::atomic<uint64_t> n_dropped   { 0 };
+
+static struct {
+	std::mutex              lock;
+	std::condition_variable cv;
+	std::thread            *th              { nullptr };
+	FILE                   *fh              { nullptr };
+	bool                    flush_requested { false   };
+	bool                    quit            { false   };
+} writer;
+
+void trace_log_add(const char *const fmt, va_list ap)
+{
+	uint64_t      pos   = enqueue_pos.load(std::memory_order_relaxed);
+	trace_slot_t *slot  = nullptr;
+	uint64_t      index = 0;
+
+	for(;;) {
+		index = pos & (trace_ring_size - 1);
+		slot  = &ring[index];
+
+		int64_t diff = int64_t(slot->sequence.load(std::memory_order_acquire) + index) - int64_t(pos);
+		if (diff == 0) {
+			if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				break;
+		}
+		else if (diff < 0) {  // full
+			n_dropped++;
+			return;
+		}
+		else {
+			pos = enqueue_pos.load(std::memory_order_relaxed);
+		}
+	}
+
+	slot->ts = esp_timer_get_time();
+	vsnprintf(slot->text, sizeof slot->text, fmt, ap);
+
+	slot->sequence.store(pos + 1 - index, std::memory_order_release);
+}
+
+// returns false when nothing was queued
+static bool write_slot()
+{
+	uint64_t      index = dequeue_pos & (trace_ring_size - 1);
+	trace_slot_t *slot  = &ring[index];
+	if (slot->sequence.load(std::memory_order_acquire) + index != dequeue_pos + 1)
+		return false;
+
+	// only this thread uses localtime()
+	time_t t  = slot->ts / 1000000;
+	tm    *tm = localtime(&t);
+	fprintf(writer.fh, "[%d] %04d-%02d-%02d %02d:%02d:%02d.%06d %s", getpid(),
+			tm->tm_year + 1900, tm->tm_mon + 1, tm->tm_mday,
+			tm->tm_hour, tm->tm_min, tm->tm_sec,
+			int(slot->ts % 1000000), slot->text);
+
+	slot->sequence.store(dequeue_pos + trace_ring_size - index, std::memory_order_release);
+	dequeue_pos++;
+
+	return true;
+}
+
+static void writer_thread()
+{
+	std::unique_lock<std::mutex> lck(writer.lock);
+
+	for(;;) {
+		bool flush = writer.flush_requested;
+		bool quit  = writer.quit;
+		writer.flush_requested = false;
+		lck.unlock();
+
+		while(write_slot()) {
+		}
+
+		uint64_t dropped = n_dropped.exchange(0);
+		if (dropped)
+			fprintf(writer.fh, "# trace ring full: %" PRIu64 " lines dropped\n", dropped);
+
+		if (flush || quit)
+			fflush(writer.fh);
+
+		lck.lock();
+		if (quit)
+			break;
+
+		writer.cv.wait_for(lck, std::chrono::milliseconds(100), [] { return writer.flush_requested || writer.quit; });
+	}
+}
+
+bool trace_log_open(const std::string & file)
+{
+	std::unique_lock<std::mutex> lck(writer.lock);
+	if (writer.th)
+		return true;
+
+	writer.fh = fopen(file.c_str(), "a+");
+	if (!writer.fh) {
+		fprintf(stderr, "Cannot access %s: %s\n", file.c_str(), strerror(errno));
+		return false;
+	}
+
+	writer.th = new std::thread(writer_thread);
+
+	atexit(trace_log_close);
+
+	return true;
+}
+
+void trace_log_flush()
+{
+	std::unique_lock<std::mutex> lck(writer.lock);
+	writer.flush_requested = true;
+	writer.cv.notify_one();
+}
+
+void trace_log_close()
+{
+	std::unique_lock<std::mutex> lck(writer.lock);
+	if (!writer.th)
+		return;
+
+	writer.quit = true;
+	writer.cv.notify_one();
+	lck.unlock();
+
+	writer.th->join();
+
+	lck.lock();
+	delete writer.th;
+	writer.th = nullptr;
+
+	fclose(writer.fh);
+	writer.fh = nullptr;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstdarg>
+#include <string>
+
+
+// the file of my_trace() (-R): threads only format their line into a lock-free
+// ring buffer, a background thread does the writing
+bool trace_log_open(const std::string & file);
+// lines that do not fit in the ring are dropped (and counted)
+void trace_log_add(const char *const fmt, va_list ap);
+// asks the writer to write and fflush() what is queued, does not wait for it
+void trace_log_flush();
+void trace_log_close();
@@ -0,0 +1,212 @@
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "treerec.h"
+
+#if defined(WITH_TREE_RECORDER)
+
+std::atomic_bool      tree_recorder_enabled     { false };
+std::atomic<uint64_t> tree_recorder_sample_mask { 0     };
+
+constexpr char   trec_magic[8]   = { 'D', 'O', 'G', 'T', 'R', 'E', 'E', '1' };
+constexpr size_t trec_ring_size  = 16384;  // records per thread
+constexpr int    trec_max_depth  = 64;
+constexpr int    trec_max_index  = 32;
+
+static std::mutex file_lock;
+static FILE      *file_fh = nullptr;
+
+typedef struct {
+	tree_record_t records[trec_ring_size];
+	size_t        n { 0 };
+} tree_ring_t;
+
+static void write_ring(tree_ring_t *const ring)
+{
+	std::unique_lock<std::mutex> lck(file_lock);
+	if (file_fh && fwrite(ring->records, sizeof(tree_record_t), ring->n, file_fh) != ring->n)
+		printf("# tree recorder: write error\n");
+	ring->n = 0;
+}
+
+// per thread, so that recording needs no locking; written and freed when the thread ends
+static thread_local struct tree_ring_owner_t {
+	tree_ring_t *ring { nullptr };
+
+	~tree_ring_owner_t()
+	{
+		if (ring && ring->n)
+			write_ring(ring);
+		delete ring;
+	}
+} owner;
+
+bool tree_recorder_start(const std::string & file, const int sample_bits)
+{
+	tree_recorder_stop();
+
+	std::unique_lock<std::mutex> lck(file_lock);
+	file_fh = fopen(file.c_str(), "wb");
+	if (!file_fh) {
+		printf("# cannot create %s\n", file.c_str());
+		return false;
+	}
+
+	uint32_t record_size = sizeof(tree_record_t);
+	fwrite(trec_magic, sizeof trec_magic, 1, file_fh);
+	fwrite(&record_size, sizeof record_size, 1, file_fh);
+
+	tree_recorder_sample_mask = sample_bits > 0 ? (uint64_t(1) << std::min(sample_bits, 63)) - 1 : 0;
+	tree_recorder_enabled     = true;
+
+	return true;
+}
+
+void tree_recorder_stop()
+{
+	tree_recorder_enabled = false;
+
+	std::unique_lock<std::mutex> lck(file_lock);
+	if (file_fh) {
+		fclose(file_fh);
+		file_fh = nullptr;
+	}
+}
+
+void tree_record(const tree_record_t & record)
+{
+	if (!owner.ring)
+		owner.ring = new tree_ring_t;
+
+	tree_ring_t *ring = owner.ring;
+	ring->records[ring->n++] = record;
+	if (ring->n == trec_ring_size)
+		write_ring(ring);
+}
+
+void tree_recorder_flush()
+{
+	if (owner.ring && owner.ring->n)
+		write_ring(owner.ring);
+}
+
+static const char *decision_name(const int decision)
+{
+	const char *const names[] = { "searched", "TT", "syzygy", "rev. futility", "null move", "multi-cut" };
+
+	return decision >= 0 && decision < DEC_N ? names[decision] : "?";
+}
+
+void tree_dump(const std::string & file)
+{
+	FILE *fh = fopen(file.c_str(), "rb");
+	if (!fh) {
+		printf("# cannot open %s\n", file.c_str());
+		return;
+	}
+
+	char     magic[sizeof trec_magic] { };
+	uint32_t record_size = 0;
+	if (fread(magic, sizeof magic, 1, fh) != 1 || fread(&record_size, sizeof record_size, 1, fh) != 1 ||
+	    memcmp(magic, trec_magic, sizeof magic) != 0 || record_size != sizeof(tree_record_t)) {
+		printf("# %s is not a tree recording of this version\n", file.c_str());
+		fclose(fh);
+		return;
+	}
+
+	// [depth][cut-off index], the last column is "trec_max_index or later"
+	std::vector<std::vector<uint64_t> > cutoff_index(trec_max_depth, std::vector<uint64_t>(trec_max_index + 1));
+	// [depth][decision]
+	std::vector<std::vector<uint64_t> > decisions(trec_max_depth, std::vector<uint64_t>(DEC_N));
+	std::vector<uint64_t> tt_hits(trec_max_depth);
+	std::vector<uint64_t> node_types[3] { std::vector<uint64_t>(trec_max_depth), std::vector<uint64_t>(trec_max_depth), std::vector<uint64_t>(trec_max_depth) };
+	// [move number]
+	std::vector<uint64_t> lmr(trec_max_index + 1);
+	std::vector<uint64_t> lmr_re_search(trec_max_index + 1);
+
+	uint64_t      n_records = 0;
+	tree_record_t r { };
+	while(fread(&r, sizeof r, 1, fh) == 1) {
+		n_records++;
+
+		int depth = std::clamp(int(r.depth), 0, trec_max_depth - 1);
+		int index = std::min(int(r.index), trec_max_index);
+
+		if (r.kind == TREC_LMR) {
+			lmr[index]++;
+			if (r.flags & trec_lmr_re_search)
+				lmr_re_search[index]++;
+			continue;
+		}
+
+		if (r.decision < DEC_N)
+			decisions[depth][r.decision]++;
+		if (r.flags & trec_tt_hit)
+			tt_hits[depth]++;
+		if (r.node_type <= NODE_ALL)
+			node_types[r.node_type][depth]++;
+		if (r.decision == DEC_SEARCHED && r.index != trec_no_index)
+			cutoff_index[depth][index]++;
+	}
+
+	fclose(fh);
+
+	printf("# %" PRIu64 " records\n", n_records);
+
+	printf("# node decisions by depth\n");
+	printf("depth     nodes  tt hit%%     pv%%    cut%%    all%%");
+	for(int d=0; d<DEC_N; d++)
+		printf(" %13s", decision_name(d));
+	printf("\n");
+	for(int depth=0; depth<trec_max_depth; depth++) {
+		uint64_t n = 0;
+		for(auto count: decisions[depth])
+			n += count;
+		if (n == 0)
+			continue;
+
+		printf("%5d %9" PRIu64 " %7.2f %7.2f %7.2f %7.2f", depth, n, tt_hits[depth] * 100. / n, node_types[NODE_PV][depth] * 100. / n, node_types[NODE_CUT][depth] * 100. / n, node_types[NODE_ALL][depth] * 100. / n);
+		for(int d=0; d<DEC_N; d++)
+			printf(" %12.2f%%", decisions[depth][d] * 100. / n);
+		printf("\n");
+	}
+
+	printf("# cut-off move index by depth (%% of the searched nodes that failed high)\n");
+	printf("depth  cut-offs   avg idx       0       1       2       3     4-7    8-15     16+\n");
+	const int bucket_end[] = { 1, 2, 3, 4, 8, 16, trec_max_index + 1 };
+	for(int depth=0; depth<trec_max_depth; depth++) {
+		uint64_t n   = 0;
+		uint64_t sum = 0;
+		for(int i=0; i<=trec_max_index; i++) {
+			n   += cutoff_index[depth][i];
+			sum += cutoff_index[depth][i] * i;
+		}
+		if (n == 0)
+			continue;
+
+		printf("%5d %9" PRIu64 " %9.2f", depth, n, sum / double(n));
+		int i = 0;
+		for(int end: bucket_end) {
+			uint64_t bucket = 0;
+			for(; i<end; i++)
+				bucket += cutoff_index[depth][i];
+			printf(" %7.2f", bucket * 100. / n);
+		}
+		printf("\n");
+	}
+
+	printf("# LMR re-search rate by move number\n");
+	printf("move   reduced  re-search%%\n");
+	for(int i=0; i<=trec_max_index; i++) {
+		if (lmr[i] == 0)
+			continue;
+
+		printf("%3d%s %9" PRIu64 " %10.2f\n", i, i == trec_max_index ? "+" : " ", lmr[i], lmr_re_search[i] * 100. / lmr[i]);
+	}
+}
+#endif
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+
+// records (a sample of) the search tree to a file for offline analysis, only
+// when built with TREE_RECORDER=1 (see the CMakeLists.txt); "treedump" reads it
+typedef enum { TREC_NODE, TREC_LMR } tree_record_kind_t;
+
+// how a node ended
+typedef enum { DEC_SEARCHED, DEC_TT_CUTOFF, DEC_SYZYGY, DEC_REVERSE_FUTILITY, DEC_NULL_MOVE, DEC_MULTI_CUT, DEC_N } tree_decision_t;
+
+typedef enum { NODE_PV, NODE_CUT, NODE_ALL } tree_node_type_t;
+
+constexpr uint8_t trec_tt_hit        = 1;
+constexpr uint8_t trec_lmr_re_search = 2;
+
+constexpr uint8_t trec_no_index      = 255;
+
+typedef struct {
+	uint32_t move;          // TREC_NODE: best move, TREC_LMR: the reduced move
+	int16_t  alpha;
+	int16_t  beta;
+	int16_t  score;
+	uint8_t  ply;
+	int8_t   depth;
+	uint8_t  kind;          // tree_record_kind_t
+	uint8_t  node_type;     // tree_node_type_t
+	uint8_t  decision;      // tree_decision_t
+	uint8_t  index;         // TREC_NODE: index of the cut-off move, TREC_LMR: move number
+	uint8_t  flags;
+	uint8_t  thread_nr;
+	uint8_t  pad[2];
+} tree_record_t;
+
+#if defined(WITH_TREE_RECORDER)
+// set by the UCI thread, read by the search threads
+extern std::atomic_bool      tree_recorder_enabled;
+extern std::atomic<uint64_t> tree_recorder_sample_mask;
+
+// sampling is by position hash: a sampled position is recorded in every thread
+inline bool tree_record_sampled(const uint64_t hash)
+{
+	return tree_recorder_enabled.load(std::memory_order_relaxed) && (hash & tree_recorder_sample_mask.load(std::memory_order_relaxed)) == 0;
+}
+
+// 1 in 2^sample_bits positions is recorded
+bool tree_recorder_start(const std::string & file, const int sample_bits);
+void tree_recorder_stop();
+
+void tree_record(const tree_record_t & record);
+// writes the buffer of the calling thread to the file
+void tree_recorder_flush();
+
+void tree_dump(const std::string & file);
+#else
+inline bool tree_record_sampled(const uint64_t)
+{
+	return false;
+}
+
+inline void tree_record(const tree_record_t &)
+{
+}
+
+inline void tree_recorder_flush()
+{
+}
+#endif
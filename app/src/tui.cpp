@@ -13,6 +13,7 @@
 #include "main.h"
 #include "max-ascii.h"
 #include "nnue.h"
+#include "perft.h"
 #include "san.h"
 #include "search.h"
 #include "str.h"
@@ -45,35 +46,6 @@ void my_printf(const char *const fmt, ...)
 #endif
 }
 
-uint64_t do_perft(libchess::Position &pos, int depth)
-{
-	libchess::MoveList move_list = pos.legal_move_list();
-	if (depth == 1)
-		return move_list.size();
-
-	uint64_t count     = 0;
-	for(const libchess::Move & move: move_list) {
-		pos.make_move(move);
-		count += do_perft(pos, depth - 1);
-		pos.unmake_move();
-	}
-
-	return count;
-}
-
-void perft(libchess::Position &pos, int depth)
-{
-	my_printf("Perft for fen: %s\n", pos.fen().c_str());
-
-	for(int d=1; d<=depth; d++) {
-		uint64_t t_start = esp_timer_get_time();
-		uint64_t count   = do_perft(pos, d);
-		uint64_t t_end   = esp_timer_get_time();
-		double   t_diff  = std::max(uint64_t(1), t_end - t_start) / 1000000.;
-		my_printf("%d: %" PRIu64 " (%.3f nps, %.2f seconds)\n", d, count, count / t_diff, t_diff);
-	}
-}
-
 void display(const libchess::Position & p, const bool large, const bool colors, const std::optional<std::vector<libchess::Move> > & moves, const std::vector<int16_t> & scores)
 {
 	if (!large) {
@@ -393,6 +365,7 @@ static void help()
 	my_printf("trace   on/off\n");
 	my_printf("colors  on/off\n");
 	my_printf("perft   run \"perft\" for the given depth\n");
+	my_printf("divide  perft per move for the given depth\n");
 	my_printf("...or enter a move (SAN/LAN)\n");
 }
 
@@ -453,7 +426,9 @@ void tui()
 			else if (parts[0] == "hash")
 				my_printf("Polyglot Zobrist hash: %" PRIx64 "\n", sp.at(0)->pos.hash());
 			else if (parts[0] == "perft" && parts.size() == 2)
-				perft(sp.at(0)->pos, std::stoi(parts.at(1)));
+				perft(sp.at(0)->pos, std::stoi(parts.at(1)), { int(sp.size()), 0 });
+			else if (parts[0] == "divide" && parts.size() == 2)
+				perft_divide(sp.at(0)->pos, std::stoi(parts.at(1)), { int(sp.size()), 0 });
 			else if (parts[0] == "new") {
 				stop_ponder();
 				memset(sp.at(0)->history, 0x00, history_malloc_size);
@@ -1,3 +1,2 @@
 void my_printf(const char *const fmt, ...);
-void perft(libchess::Position &pos, int depth);
 void run_tui();
@@ -109,10 +109,10 @@ void usb_disp(const std::string & device)
 		if (!send_disp_cmd(fd, myformat("score %d\n", abs(sp.at(0)->score))))
 			break;
 
-		if (!send_disp_cmd(fd, myformat("bitmap 0 %" PRIx64 "\n", wboard)))
+		if (!send_disp_cmd(fd, myformat("bitmap 0 %" PRIx64 "\n", wboard.load())))
 			break;
 
-		if (!send_disp_cmd(fd, myformat("bitmap 8 %" PRIx64 "\n", bboard)))
+		if (!send_disp_cmd(fd, myformat("bitmap 8 %" PRIx64 "\n", bboard.load())))
 			break;
 
 		for(;;) {